@@ -19,7 +19,7 @@ var writeCmd = function() {
     var offset = arguments[1];
     var data = arguments[2];
 
-    if (data.hasOwnProperty("length")) {
+    if (Buffer.isBuffer(data)) {
         // Buffer
         data.copy(buf, offset);
         return data.length;
@@ -45,6 +45,122 @@ var writeString = function(buf, offset, string) {
     return string.length;
 }
 
+// Size of packet payload in SendPackets, per packet type
+var packetPayloadSize = function(packetType) {
+    var t = cmdFormat.packetTypes;
+    if (packetType === t.Integer.id) {
+        return 4;
+    } else if (packetType === t.Byte.id || packetType === t.Boolean.id) {
+        return 1;
+    } else if (packetType === t.Void.id || packetType === t.BracketStart.id
+               || packetType === t.BracketEnd.id) {
+        return 0;
+    }
+    throw "Packet type " + packetType + " cannot be sent from host";
+}
+
+// Send many packets with one command. @runs is a list of
+// {tgt: nodeId, port: portId, type: packetTypeId, values: [...]}
+// Each run is [target, port, type, count] followed by the packed payloads
+var packetBatchCommand = function(runs) {
+    var chunks = [];
+    runs.forEach(function(run) {
+        var values = run.values || [undefined];
+        for (var start=0; start<values.length; start+=255) {
+            chunks.push({ run: run, values: values.slice(start, start+255) });
+        }
+    });
+    if (chunks.length > 255) {
+        throw "Too many runs in packet batch: " + chunks.length;
+    }
+
+    var size = cmdFormat.commandSize;
+    chunks.forEach(function(c) {
+        size += 4 + c.values.length*packetPayloadSize(c.run.type);
+    });
+    var b = new Buffer(size);
+    b.fill(0);
+    b.writeUInt8(cmdFormat.commands.SendPackets.id, 0);
+    b.writeUInt8(chunks.length, 1);
+
+    var offset = cmdFormat.commandSize;
+    chunks.forEach(function(c) {
+        b.writeUInt8(c.run.tgt, offset++);
+        b.writeUInt8(c.run.port, offset++);
+        b.writeUInt8(c.run.type, offset++);
+        b.writeUInt8(c.values.length, offset++);
+        c.values.forEach(function(v) {
+            offset += writePayload(b, offset, c.run.type, v);
+        });
+    });
+    return b;
+}
+
+var writePayload = function(b, offset, type, value) {
+    if (type === cmdFormat.packetTypes.Integer.id) {
+        b.writeInt32LE(value, offset);
+    } else if (type === cmdFormat.packetTypes.Byte.id) {
+        b.writeUInt8(value, offset);
+    } else if (type === cmdFormat.packetTypes.Boolean.id) {
+        b.writeUInt8(value ? 1 : 0, offset);
+    }
+    return packetPayloadSize(type);
+}
+
+// Bind @stream to a port. Device answers with StreamOpened, giving the number of
+// packets that may be in flight. 0 for @window means as many as device can take
+var openStreamCommand = function(stream, tgt, port, window) {
+    var b = new Buffer(cmdFormat.commandSize);
+    writeCmd(b, 0, cmdFormat.commands.OpenStream.id, stream, tgt, port, window || 0);
+    return b;
+}
+
+// Up to 255 @values of packet @type to an open stream, packed like a SendPackets run
+var streamDataCommand = function(stream, type, values) {
+    if (values.length > 255) {
+        throw "Too many values in stream data: " + values.length;
+    }
+    var size = packetPayloadSize(type);
+    var b = new Buffer(cmdFormat.commandSize + values.length*size);
+    b.fill(0);
+    writeCmd(b, 0, cmdFormat.commands.StreamData.id, stream, type, values.length);
+    values.forEach(function(v, i) {
+        writePayload(b, cmdFormat.commandSize + i*size, type, v);
+    });
+    return b;
+}
+
+// Ask a running device for the least free stack seen since reset, answered with StackUsage.
+// With @alarmThreshold (bytes), device also raises DebugStackLow once if free stack goes below it.
+// Prefixed with the magic, as device looks for it again after a graph upload
+var queryStackUsageCommand = function(alarmThreshold) {
+    var threshold = alarmThreshold || 0;
+    if (threshold < 0 || threshold > 0xFFFF) {
+        throw "Stack alarm threshold out of range: " + alarmThreshold;
+    }
+    var b = new Buffer(cmdFormat.commandSize*2);
+    writeString(b, 0, cmdFormat.magicString);
+    writeCmd(b, cmdFormat.commandSize, cmdFormat.commands.QueryStackUsage.id, threshold & 0xFF, threshold >> 8);
+    return b;
+}
+
+// Length of the command starting at @offset, including any batched packets
+var commandLength = function(cmdStream, offset) {
+    if (cmdStream[offset] === cmdFormat.commands.StreamData.id) {
+        return cmdFormat.commandSize + cmdStream[offset+3]*packetPayloadSize(cmdStream[offset+2]);
+    }
+    if (cmdStream[offset] !== cmdFormat.commands.SendPackets.id) {
+        return cmdFormat.commandSize;
+    }
+    var length = cmdFormat.commandSize;
+    var runs = cmdStream[offset+1];
+    for (var i=0; i<runs; i++) {
+        var run = offset+length;
+        length += 4 + cmdStream[run+3]*packetPayloadSize(cmdStream[run+2]);
+    }
+    return length;
+}
+
 var dataLiteralToCommand = function(literal, tgt, tgtPort) {
     literal = literal.replace("^\"|\"$", "");
 
@@ -81,40 +197,16 @@ var dataLiteralToCommand = function(literal, tgt, tgtPort) {
         throw "Unknown IIP data type for literal '" + literal + "' :" + err;
     }
 
-    // Array of bytes/integers
+    // Array of bytes/integers, sent as one batch
     var isByteArray = typeof value[0] === 'string';
     if (true) {
-        var b = new Buffer(cmdFormat.commandSize*(value.length+2));
-        var offset = 0;
-        b.fill(0, offset, offset+cmdFormat.commandSize);
-        b.writeUInt8(cmdFormat.commands.SendPacket.id, offset+0);
-        b.writeUInt8(tgt, offset+1);
-        b.writeUInt8(tgtPort, offset+2);
-        b.writeInt8(cmdFormat.packetTypes.BracketStart.id, offset+3)
-        offset += cmdFormat.commandSize;
-
-        for (var i=0; i<value.length; i++) {
-            b.fill(0, offset, offset+cmdFormat.commandSize);
-            b.writeUInt8(cmdFormat.commands.SendPacket.id, offset+0);
-            b.writeUInt8(tgt, offset+1);
-            b.writeUInt8(tgtPort, offset+2);
-            var v = parseInt(value[i]);
-            if (isByteArray) {
-                b.writeInt8(cmdFormat.packetTypes.Byte.id, offset+3);
-                b.writeUInt8(v, offset+4);
-            } else {
-                b.writeInt8(cmdFormat.packetTypes.Integer.id, offset+3);
-                b.writeInt32LE(v, offset+4);
-            }
-            offset += cmdFormat.commandSize;
-        }
-        b.fill(0, offset, offset+cmdFormat.commandSize);
-        b.writeUInt8(cmdFormat.commands.SendPacket.id, offset+0);
-        b.writeUInt8(tgt, offset+1);
-        b.writeUInt8(tgtPort, offset+2);
-        b.writeInt8(cmdFormat.packetTypes.BracketEnd.id, offset+3)
-        offset += cmdFormat.commandSize;
-        return b;
+        var values = value.map(function(v) { return parseInt(v); });
+        return packetBatchCommand([
+            { tgt: tgt, port: tgtPort, type: cmdFormat.packetTypes.BracketStart.id },
+            { tgt: tgt, port: tgtPort, values: values,
+              type: isByteArray ? cmdFormat.packetTypes.Byte.id : cmdFormat.packetTypes.Integer.id },
+            { tgt: tgt, port: tgtPort, type: cmdFormat.packetTypes.BracketEnd.id }
+        ]);
     }
 
 
@@ -122,6 +214,31 @@ var dataLiteralToCommand = function(literal, tgt, tgtPort) {
     // TODO: handle floats, strings
 }
 
+// Port types follow NoFlo conventions, untyped ports accept "all"
+var portTypesCompatible = function(srcType, tgtType) {
+    srcType = srcType || "all";
+    tgtType = tgtType || "all";
+    if (srcType === "all" || tgtType === "all" || srcType === tgtType) {
+        return true;
+    }
+    return srcType === "int" && tgtType === "number";
+}
+
+var literalPortType = function(cmd) {
+    if (cmd.readUInt8(0) === cmdFormat.commands.SendPackets.id) {
+        return "array";
+    }
+    var packetType = cmd.readUInt8(3);
+    if (packetType === cmdFormat.packetTypes.Integer.id) {
+        return "int";
+    } else if (packetType === cmdFormat.packetTypes.Boolean.id) {
+        return "boolean";
+    } else if (packetType === cmdFormat.packetTypes.BracketStart.id) {
+        return "array";
+    }
+    return "all";
+}
+
 var findPort = function(componentLib, graph, nodeName, portName) {
     var isOutput = false;
     var port = componentLib.inputPort(graph.processes[nodeName].component, portName);
@@ -200,48 +317,416 @@ var cmdStreamBuildGraph = function(currentNodeId, buffer, index, componentLib, g
     // Connect nodes
     graph.connections.forEach(function(connection) {
         if (connection.src !== undefined) {
-            var srcNode = connection.src.process;
-            var tgtNode = connection.tgt.process;
-            var srcPort = undefined;
-            var tgtPort = undefined;
-            try {
-                srcPort = componentLib.outputPort(graph.processes[srcNode].component,
-                                                  connection.src.port).id;
-                tgtPort = componentLib.inputPort(graph.processes[tgtNode].component,
-                                                 connection.tgt.port).id;
-            } catch (err) {
-                throw "Could not connect: " + srcNode + " " + connection.src.port +
-                        " -> " + connection.tgt.port + " "+ tgtNode;
-            }
-
-            if (tgtPort !== undefined && srcPort !== undefined) {
-                index += writeCmd(buffer, index, cmdFormat.commands.ConnectNodes.id,
-                                  nodeMap[srcNode].id, nodeMap[tgtNode].id, srcPort, tgtPort);
-            }
+            index += writeCmd(buffer, index, connectCommand(componentLib, graph, connection));
         }
     });
 
     // Send IIPs
     graph.connections.forEach(function(connection) {
         if (connection.data !== undefined) {
-            var tgtNode = connection.tgt.process;
-            var tgtPort = undefined;
-            try {
-                tgtPort = componentLib.inputPort(graph.processes[tgtNode].component, connection.tgt.port).id;
-            } catch (err) {
-                throw "Could not attach IIP: '" + connection.data.toString() + "' -> "
-                        + tgtPort + " " + tgtNode;
-            }
-
-            index += writeCmd(buffer, index, dataLiteralToCommand(connection.data, nodeMap[tgtNode].id, tgtPort));
+            index += writeCmd(buffer, index, initialPacketCommand(componentLib, graph, connection));
         }
     });
 
     return {index: index-startIndex, nodeId: currentNodeId};
 }
 
+// Port ids of an edge, type checked
+var edgePorts = function(componentLib, graph, connection) {
+    var srcNode = connection.src.process;
+    var tgtNode = connection.tgt.process;
+    var src = undefined;
+    var tgt = undefined;
+    try {
+        src = componentLib.outputPort(graph.processes[srcNode].component, connection.src.port);
+        tgt = componentLib.inputPort(graph.processes[tgtNode].component, connection.tgt.port);
+    } catch (err) {
+        throw "Could not connect: " + srcNode + " " + connection.src.port +
+                " -> " + connection.tgt.port + " "+ tgtNode;
+    }
+    if (!portTypesCompatible(src.type, tgt.type)) {
+        throw "Incompatible port types: " + srcNode + " " + connection.src.port +
+                " (" + src.type + ") -> " + connection.tgt.port + " " + tgtNode +
+                " (" + tgt.type + ")";
+    }
+    return { src: src.id, tgt: tgt.id };
+}
+
+var connectCommand = function(componentLib, graph, connection) {
+    var ports = edgePorts(componentLib, graph, connection);
+    var buffer = new Buffer(cmdFormat.commandSize);
+    writeCmd(buffer, 0, cmdFormat.commands.ConnectNodes.id, graph.nodeMap[connection.src.process].id,
+             graph.nodeMap[connection.tgt.process].id, ports.src, ports.tgt);
+    return buffer;
+}
+
+var initialPacketCommand = function(componentLib, graph, connection) {
+    var tgtNode = connection.tgt.process;
+    var tgtPort = undefined;
+    var tgtType = undefined;
+    try {
+        var tgt = componentLib.inputPort(graph.processes[tgtNode].component, connection.tgt.port);
+        tgtPort = tgt.id;
+        tgtType = tgt.type;
+    } catch (err) {
+        throw "Could not attach IIP: '" + connection.data.toString() + "' -> "
+                + tgtPort + " " + tgtNode;
+    }
+
+    var cmd = dataLiteralToCommand(connection.data, graph.nodeMap[tgtNode].id, tgtPort);
+    if (!portTypesCompatible(literalPortType(cmd), tgtType)) {
+        throw "Incompatible IIP type: '" + connection.data.toString() + "' -> "
+                + connection.tgt.port + " " + tgtNode + " (" + tgtType + ")";
+    }
+    return cmd;
+}
+
+// Frees ids like Network::removeNode() does: children first, then the node
+var releaseNodeIds = function(graph, nodeName) {
+    var id = graph.nodeMap[nodeName].id;
+    var children = Object.keys(graph.nodeMap).filter(function(name) {
+        return graph.nodeMap[name].parent === id;
+    }).sort(function(a, b) {
+        return graph.nodeMap[a].id - graph.nodeMap[b].id;
+    });
+    children.forEach(function(child) {
+        releaseNodeIds(graph, child);
+    });
+    graph.freeNodeIds.push(id);
+    delete graph.nodeMap[nodeName];
+}
+
+// Commands applying one change to the graph of a running network, without a reset.
+// Must be called before @graph itself is changed. Updates graph.nodeMap, predicting
+// the node id the runtime will assign.
+// @command is "addnode", "removenode" (@change is process, with .id name),
+// "addedge", "removeedge" or "addinitial" (@change is connection)
+var graphChangeCommands = function(componentLib, graph, command, change) {
+    var buffer = new Buffer(cmdFormat.commandSize);
+    if (command === "addnode") {
+        var comp = componentLib.getComponent(change.component);
+        if (!comp) {
+            throw "Unknown component: " + change.component;
+        }
+        if (comp.graph || comp.graphFile) {
+            throw "Subgraphs cannot be added to a running network";
+        }
+        var id = graph.freeNodeIds.length ? graph.freeNodeIds.pop() : graph.nextNodeId++;
+        graph.nodeMap[change.id] = {id: id};
+        writeCmd(buffer, 0, cmdFormat.commands.CreateComponent.id, comp.id, 0);
+    } else if (command === "removenode") {
+        writeCmd(buffer, 0, cmdFormat.commands.RemoveNode.id, graph.nodeMap[change.id].id);
+        releaseNodeIds(graph, change.id);
+    } else if (command === "addedge") {
+        buffer = connectCommand(componentLib, graph, change);
+    } else if (command === "removeedge") {
+        if (!graph.nodeMap[change.src.process] || !graph.nodeMap[change.tgt.process]) {
+            // Runtime disconnected it when removing the node
+            return new Buffer(0);
+        }
+        var ports = edgePorts(componentLib, graph, change);
+        writeCmd(buffer, 0, cmdFormat.commands.DisconnectNodes.id,
+                 graph.nodeMap[change.src.process].id, ports.src);
+    } else if (command === "addinitial") {
+        buffer = initialPacketCommand(componentLib, graph, change);
+    } else {
+        throw "Cannot change running network: " + command;
+    }
+    return buffer;
+}
+
+// Compact framing: commands are COBS encoded without their trailing zero padding,
+// and terminated by 0x00. This allows the receiver to resynchronize on next frame.
+// http://en.wikipedia.org/wiki/Consistent_Overhead_Byte_Stuffing
+var cobsEncode = function(cmd, keepPadding) {
+    var length = cmd.length;
+    while (!keepPadding && length > 1 && cmd[length-1] === 0) {
+        length--;
+    }
+    var out = [];
+    var start = 0;
+    while (start <= length) {
+        var end = start;
+        while (end < length && cmd[end] !== 0 && end-start < 254) {
+            end++;
+        }
+        out.push(end-start+1);
+        for (var i=start; i<end; i++) {
+            out.push(cmd[i]);
+        }
+        // Block of 254 bytes (code 0xFF) is not followed by an implied zero
+        start = (end-start === 254) ? end : end+1;
+    }
+    out.push(0);
+    return new Buffer(out);
+}
+
+// Decode a frame (excluding delimiter) into a fixed size, zero-padded command,
+// or a longer one with batched packets
+var cobsDecode = function(frame) {
+    var cmd = new Buffer(Math.max(cmdFormat.commandSize, frame.length));
+    cmd.fill(0);
+    var length = 0;
+    var index = 0;
+    while (index < frame.length) {
+        var code = frame[index++];
+        if (code === 0 || index+code-1 > frame.length) {
+            throw "Invalid COBS frame";
+        }
+        for (var i=1; i<code; i++) {
+            cmd[length++] = frame[index++];
+        }
+        if (code < 0xFF && index < frame.length) {
+            cmd[length++] = 0;
+        }
+    }
+    return cmd.slice(0, Math.max(cmdFormat.commandSize, length));
+}
+
+var isCompactStream = function(cmdStream) {
+    var magic = cmdFormat.compactMagicString;
+    return cmdStream.length >= magic.length && cmdStream.toString("ascii", 0, magic.length) === magic;
+}
+
+// Convert stream of fixed size commands, with leading magic string, to compact framing
+var toCompactStream = function(cmdStream) {
+    var magic = cmdFormat.magicString;
+    if (cmdStream.toString("ascii", 0, magic.length) !== magic) {
+        throw "Command stream does not start with magic string";
+    }
+    var parts = [new Buffer(cmdFormat.compactMagicString, "ascii")];
+    for (var i=magic.length; i<cmdStream.length; ) {
+        // Batched packets go in the same frame, and must not lose trailing zeros
+        var length = commandLength(cmdStream, i);
+        parts.push(cobsEncode(cmdStream.slice(i, i+length), length > cmdFormat.commandSize));
+        i += length;
+    }
+    return Buffer.concat(parts);
+}
+
+// CRC-16-CCITT, polynomial 0x1021. Used by block upload
+var crc16 = function(data, crc) {
+    crc = (crc === undefined) ? 0xFFFF : crc;
+    for (var i=0; i<data.length; i++) {
+        crc ^= data[i] << 8;
+        for (var j=0; j<8; j++) {
+            crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+            crc &= 0xFFFF;
+        }
+    }
+    return crc;
+}
+
+// Block upload: this stream puts the device into upload mode,
+// then the graph image (command stream without magic) follows as blocks
+var beginUploadStream = function(cmdStream) {
+    var magic = cmdFormat.magicString;
+    if (cmdStream.toString("ascii", 0, magic.length) !== magic) {
+        throw "Command stream does not start with magic string";
+    }
+    var b = new Buffer(magic.length+cmdFormat.commandSize);
+    var index = writeString(b, 0, magic);
+    writeCmd(b, index, cmdFormat.commands.BeginUpload.id);
+    return b;
+}
+
+// Block is [start, seq, length, crc lo, crc hi, payload...], CRC over seq, length and payload.
+// An empty block ends the upload, and then carries the CRC of the whole image instead
+var uploadBlock = function(seq, payload, imageCrc) {
+    var b = new Buffer(5+payload.length);
+    b.writeUInt8(cmdFormat.uploadBlockStart, 0);
+    b.writeUInt8(seq & 0xFF, 1);
+    b.writeUInt8(payload.length, 2);
+    var crc = (imageCrc !== undefined) ? imageCrc : crc16(payload, crc16(b.slice(1, 3)));
+    b.writeUInt16LE(crc, 3);
+    payload.copy(b, 5);
+    return b;
+}
+
+var writeVarint = function(bytes, value) {
+    do {
+        var b = value & 0x7F;
+        value = value >>> 7;
+        bytes.push(value ? b | 0x80 : b);
+    } while (value);
+    return bytes;
+}
+
+// Payload of one packet, as stored in a compressed graph image
+var compressPayload = function(type, payload) {
+    var t = cmdFormat.packetTypes;
+    if (type === t.Integer.id) {
+        var v = payload.readInt32LE(0);
+        return writeVarint([], ((v << 1) ^ (v >> 31)) >>> 0);
+    } else if (type === t.Byte.id || type === t.Boolean.id) {
+        return [payload[0]];
+    } else if (type === t.Void.id || type === t.BracketStart.id || type === t.BracketEnd.id) {
+        return [];
+    }
+    return Array.prototype.slice.call(payload, 0, 4);
+}
+
+// Compressed graph image for embedding in flash, decoded by loadEmbeddedGraph() in main.hpp.
+// The magic string is left out. Each command is a header byte, id | (argument count << 5),
+// then the arguments without trailing zero padding. SendPacket always has count 7 and then
+// target, port, type and the payload: Integer as zigzag varint, Byte/Boolean one byte.
+// Runs of SendPackets follow the command as [target, port, type, count] and payloads.
+// If the type has bit 7 set, the payload(s) equal earlier ones, and a varint of
+// the distance back to those is stored instead
+var compressCmdStream = function(cmdStream) {
+    var magic = cmdFormat.magicString;
+    if (cmdStream.toString("ascii", 0, magic.length) !== magic) {
+        throw "Command stream does not start with magic string";
+    }
+    var out = [];
+    var seen = {};
+    // @header ends with type and optionally count
+    var pushPayload = function(header, typeIndex, encoded) {
+        var key = header[typeIndex] + ":" + encoded.join(",");
+        var ref = (seen[key] !== undefined) ? writeVarint([], out.length+header.length - seen[key]) : null;
+        if (ref && ref.length < encoded.length) {
+            header[typeIndex] |= 0x80;
+            out.push.apply(out, header.concat(ref));
+        } else {
+            out.push.apply(out, header);
+            seen[key] = out.length;
+            out.push.apply(out, encoded);
+        }
+    }
+
+    for (var i=magic.length; i<cmdStream.length; ) {
+        var id = cmdStream[i];
+        if (id >= 32) {
+            throw "Command " + id + " cannot be in a compressed graph image";
+        }
+        if (id === cmdFormat.commands.SendPacket.id) {
+            var type = cmdStream[i+3];
+            pushPayload([id | 7<<5, cmdStream[i+1], cmdStream[i+2], type],
+                        3, compressPayload(type, cmdStream.slice(i+4, i+8)));
+            i += cmdFormat.commandSize;
+            continue;
+        }
+
+        var args = Array.prototype.slice.call(cmdStream, i+1, i+cmdFormat.commandSize);
+        while (args.length && args[args.length-1] === 0) {
+            args.pop();
+        }
+        out.push(id | args.length<<5);
+        out.push.apply(out, args);
+
+        var length = commandLength(cmdStream, i);
+        var run = i+cmdFormat.commandSize;
+        while (run < i+length) {
+            var type = cmdStream[run+2];
+            var size = packetPayloadSize(type);
+            var encoded = [];
+            for (var p=0; p<cmdStream[run+3]; p++) {
+                var start = run+4+p*size;
+                encoded.push.apply(encoded, compressPayload(type, cmdStream.slice(start, start+size)));
+            }
+            pushPayload(Array.prototype.slice.call(cmdStream, run, run+4), 2, encoded);
+            run += 4+cmdStream[run+3]*size;
+        }
+        i += length;
+    }
+    return new Buffer(out);
+}
+
+// Precompiled graph image, which the Linux runtime can mmap and build the network from
+// without parsing. [magic, crc, nodeCount, edgeCount, portCount] (16 bit LE) header,
+// then arguments of CreateComponent (2 bytes), ConnectNodes (4) and ConnectSubgraphPort (5),
+// and last the remaining commands (config, IIPs, End) unchanged. CRC covers all after header
+var graphImageFromCmdStream = function(cmdStream) {
+    var magic = cmdFormat.magicString;
+    if (cmdStream.toString("ascii", 0, magic.length) !== magic) {
+        throw "Command stream does not start with magic string";
+    }
+    var cmds = cmdFormat.commands;
+    var nodes = [], edges = [], ports = [], rest = [];
+    for (var i=magic.length; i<cmdStream.length; ) {
+        var length = commandLength(cmdStream, i);
+        var id = cmdStream[i];
+        if (id === cmds.CreateComponent.id) {
+            nodes.push(cmdStream.slice(i+1, i+3));
+        } else if (id === cmds.ConnectNodes.id) {
+            edges.push(cmdStream.slice(i+1, i+5));
+        } else if (id === cmds.ConnectSubgraphPort.id) {
+            ports.push(cmdStream.slice(i+1, i+6));
+        } else if (id !== cmds.Reset.id) {
+            rest.push(cmdStream.slice(i, i+length));
+        }
+        i += length;
+    }
+
+    var body = Buffer.concat(nodes.concat(edges, ports, rest));
+    var header = new Buffer(cmdFormat.graphImageMagicString.length+8);
+    var index = writeString(header, 0, cmdFormat.graphImageMagicString);
+    header.writeUInt16LE(crc16(body), index);
+    header.writeUInt16LE(nodes.length, index+2);
+    header.writeUInt16LE(edges.length, index+4);
+    header.writeUInt16LE(ports.length, index+6);
+    return Buffer.concat([header, body]);
+}
+
+// Parse a subscription spec like "all", "every:10", "rate:100" or "summary:1000"
+// Returns the mode id and its period (packets or milliseconds)
+var parseSubscriptionMode = function(spec) {
+    var modes = { all: "All", every: "EveryNth", rate: "RateLimit", summary: "Summary" };
+    var parts = (spec || "all").split(":");
+    var mode = cmdFormat.subscriptionModes[modes[parts[0]]];
+    var param = parts.length > 1 ? parseInt(parts[1]) : 0;
+    if (!mode || parts.length > 2 || isNaN(param) || param < 0 || param > 0xFFFF
+        || (mode.id !== cmdFormat.subscriptionModes.All.id && !param)) {
+        throw "Invalid subscription mode: " + spec;
+    }
+    return { id: mode.id, param: param };
+}
+
+// Decode records of a TelemetryData command. @channels maps channel id to an object,
+// where the last integer is kept for following deltas
+var decodeTelemetry = function(cmdData, channels) {
+    var t = cmdFormat.packetTypes;
+    var records = [];
+    var index = 1;
+    while (index < cmdData.length && cmdData[index] !== 0) {
+        var channel = cmdData[index] >> 4;
+        var type = cmdData[index] & 0x0F;
+        var state = channels[channel] = channels[channel] || { last: 0 };
+        var data = null;
+        index += 1;
+        if (type === 0x0F) {
+            var zigzag = 0;
+            var shift = 0;
+            do {
+                zigzag += (cmdData[index] & 0x7F) * Math.pow(2, shift);
+                shift += 7;
+            } while (cmdData[index++] & 0x80);
+            var delta = (zigzag % 2) ? -(zigzag+1)/2 : zigzag/2;
+            data = state.last = (state.last + delta) | 0;
+            type = t.Integer.id;
+        } else if (type === t.Integer.id) {
+            data = state.last = cmdData.readInt32LE(index);
+            index += 4;
+        } else if (type === t.Float.id) {
+            data = cmdData.readFloatLE(index);
+            index += 4;
+        } else if (type === t.Boolean.id) {
+            data = cmdData[index++] ? true : false;
+        } else if (type === t.Byte.id) {
+            data = cmdData[index++];
+        } else if (type === t.Ascii.id) {
+            data = String.fromCharCode(cmdData[index++]);
+        } else if (type !== t.Void.id && type !== t.BracketStart.id && type !== t.BracketEnd.id) {
+            throw "Invalid telemetry record type: " + type;
+        }
+        records.push({ channel: channel, type: type, data: data });
+    }
+    return records;
+}
+
 // TODO: actually add observers to graph, and emit a command stream for the changes
-var cmdStreamFromGraph = function(componentLib, graph, debugLevel) {
+// @telemetry is "packet" (default), "delta" or "delta:N" with keyframe every N samples
+var cmdStreamFromGraph = function(componentLib, graph, debugLevel, telemetry) {
     debugLevel = debugLevel || "Error";
     var buffer = new Buffer(1024); // FIXME: unhardcode
     var index = 0;
@@ -258,6 +743,15 @@ var cmdStreamFromGraph = function(componentLib, graph, debugLevel) {
     // Config
     index += writeCmd(buffer, index, cmdFormat.commands.ConfigureDebug.id,
                       cmdFormat.debugLevels[debugLevel].id);
+    if (telemetry && telemetry !== "packet") {
+        var parts = telemetry.split(":");
+        var interval = parts.length > 1 ? parseInt(parts[1]) : 0;
+        if (parts[0] !== "delta" || parts.length > 2 || isNaN(interval) || interval < 0 || interval > 255) {
+            throw "Invalid telemetry encoding: " + telemetry;
+        }
+        index += writeCmd(buffer, index, cmdFormat.commands.ConfigureTelemetry.id,
+                          cmdFormat.telemetryEncodings.Delta.id, interval);
+    }
 
     // Actual graph
     var r = cmdStreamBuildGraph(currentNodeId, buffer, index, componentLib, graph);
@@ -267,15 +761,36 @@ var cmdStreamFromGraph = function(componentLib, graph, debugLevel) {
     // Mark end of commands
     index += writeCmd(buffer, index, cmdFormat.commands.End.id);
 
+    // Runtime allocates ids for nodes added later from these, see graphChangeCommands()
+    graph.nextNodeId = currentNodeId;
+    graph.freeNodeIds = [];
+
     buffer = buffer.slice(0, index);
     return buffer;
 }
 
 module.exports = {
     cmdStreamFromGraph: cmdStreamFromGraph,
+    graphChangeCommands: graphChangeCommands,
     dataLiteralToCommand: dataLiteralToCommand,
+    packetBatchCommand: packetBatchCommand,
+    openStreamCommand: openStreamCommand,
+    streamDataCommand: streamDataCommand,
+    queryStackUsageCommand: queryStackUsageCommand,
+    portTypesCompatible: portTypesCompatible,
     writeCmd: writeCmd,
     writeString: writeString,
+    cobsEncode: cobsEncode,
+    cobsDecode: cobsDecode,
+    isCompactStream: isCompactStream,
+    toCompactStream: toCompactStream,
+    crc16: crc16,
+    beginUploadStream: beginUploadStream,
+    uploadBlock: uploadBlock,
+    graphImageFromCmdStream: graphImageFromCmdStream,
+    compressCmdStream: compressCmdStream,
+    parseSubscriptionMode: parseSubscriptionMode,
+    decodeTelemetry: decodeTelemetry,
     cmdFormat: cmdFormat, // deprecated
     format: cmdFormat,
     Buffer: Buffer
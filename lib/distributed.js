@@ -0,0 +1,233 @@
+/* MicroFlo - Flow-Based Programming for microcontrollers
+ * Copyright (c) 2014 Jon Nordby <jononor@gmail.com>
+ * MicroFlo may be freely distributed under the MIT license
+ */
+
+// Running one graph across several runtimes, for instance part on a Linux host
+// and part on a microcontroller. Each edge between runtimes is cut into a RemoteOut
+// node on the source side and a RemoteIn node on the target side. Host subscribes to
+// edges into RemoteOut, and sends the packets on to the matching RemoteIn.
+//
+// Runtimes do not talk to each other directly: every packet on a remote edge goes through
+// this host process, over the transports it uses to upload the graphs. Only packet types
+// SendPackets can carry (Integer, Boolean, Byte, Void, brackets) are forwarded. Float and
+// Ascii packets on a remote edge are dropped, and reported with UNSUPPORTED.
+
+var commandstream = require("./commandstream");
+var runtime = require("./runtime");
+var serial = require("./serial");
+var cmdFormat = require("./commandformat");
+
+// Runtime @process runs on: from @assignment (process name -> runtime name),
+// else from process metadata, else @defaultRuntime
+var runtimeOf = function(graph, process, assignment, defaultRuntime) {
+    if (assignment && assignment[process]) {
+        return assignment[process];
+    }
+    var metadata = graph.processes[process] ? graph.processes[process].metadata : undefined;
+    if (metadata && metadata.runtime) {
+        return metadata.runtime;
+    }
+    return defaultRuntime;
+}
+
+// Returns a graph per runtime, and the edges between them
+var partitionGraph = function(graph, assignment, defaultRuntime) {
+    if (graph.exports && graph.exports.length) {
+        throw "Graphs with exported ports cannot be partitioned";
+    }
+
+    var partitions = {};
+    var remoteEdges = [];
+    var partition = function(name) {
+        if (!partitions[name]) {
+            partitions[name] = { processes: {}, connections: [], exports: [] };
+        }
+        return partitions[name];
+    }
+
+    Object.keys(graph.processes).forEach(function(name) {
+        partition(runtimeOf(graph, name, assignment, defaultRuntime)).processes[name] = graph.processes[name];
+    });
+
+    graph.connections.forEach(function(connection) {
+        var tgtRuntime = runtimeOf(graph, connection.tgt.process, assignment, defaultRuntime);
+        if (!connection.src) {
+            // IIP
+            partition(tgtRuntime).connections.push(connection);
+            return;
+        }
+        var srcRuntime = runtimeOf(graph, connection.src.process, assignment, defaultRuntime);
+        if (srcRuntime === tgtRuntime) {
+            partition(srcRuntime).connections.push(connection);
+            return;
+        }
+
+        var proxy = "remote" + remoteEdges.length + "_" + connection.src.process + "_" + connection.tgt.process;
+        partition(srcRuntime).processes[proxy] = { component: "RemoteOut" };
+        partition(srcRuntime).connections.push({ src: connection.src, tgt: { process: proxy, port: "in" } });
+        partition(tgtRuntime).processes[proxy] = { component: "RemoteIn" };
+        partition(tgtRuntime).connections.push({ src: { process: proxy, port: "out" }, tgt: connection.tgt });
+        remoteEdges.push({ proxy: proxy, src: srcRuntime, tgt: tgtRuntime, edge: connection });
+    });
+
+    return { partitions: partitions, remoteEdges: remoteEdges };
+}
+
+// Forwards packets to one runtime in SendPackets batches. Stops writing while the
+// transport is congested, and drops the oldest packets if more than @maxQueued wait
+var PacketForwarder = function(transport, maxQueued) {
+    this.transport = transport;
+    this.maxQueued = maxQueued;
+    this.queue = [];
+    this.congested = false;
+    this.dropped = 0;
+    this.ready = false;
+    this.headerSent = false;
+
+    var self = this;
+    if (transport.on) {
+        transport.on("drain", function() {
+            self.congested = false;
+            self.flush();
+        });
+    }
+}
+
+PacketForwarder.prototype.push = function(tgt, port, type, data) {
+    if (this.queue.length >= this.maxQueued) {
+        this.queue.shift();
+        this.dropped++;
+    }
+    this.queue.push({ tgt: tgt, port: port, type: type, data: data });
+}
+
+PacketForwarder.prototype.flush = function() {
+    if (!this.ready || this.congested || this.queue.length === 0) {
+        return;
+    }
+
+    // Consecutive packets to the same port share a run
+    var runs = [];
+    var packets = this.queue.splice(0, 255);
+    packets.forEach(function(p) {
+        var last = runs[runs.length-1];
+        if (last && last.tgt === p.tgt && last.port === p.port && last.type === p.type) {
+            last.values.push(p.data);
+        } else {
+            runs.push({ tgt: p.tgt, port: p.port, type: p.type, values: [p.data] });
+        }
+    });
+
+    this.write(commandstream.packetBatchCommand(runs));
+}
+
+// Device is waiting for the magic string after graph upload, but takes it as a command later
+PacketForwarder.prototype.write = function(commands) {
+    if (!this.headerSent) {
+        var magic = new Buffer(cmdFormat.commandSize);
+        commandstream.writeString(magic, 0, cmdFormat.magicString);
+        commands = Buffer.concat([magic, commands]);
+        this.headerSent = true;
+    }
+    if (this.transport.write(commands) === false) {
+        this.congested = true;
+    }
+}
+
+var subscribeCommand = function(componentLib, graph, process, port) {
+    var buffer = new Buffer(cmdFormat.commandSize);
+    buffer.fill(0);
+    var portId = componentLib.outputPort(graph.processes[process].component, port).id;
+    commandstream.writeCmd(buffer, 0, cmdFormat.commands.SubscribeToPort.id,
+                           graph.nodeMap[process].id, portId, 1);
+    return buffer;
+}
+
+// Upload the partitions of @graph to runtimes, and forward packets between them.
+// @runtimes maps runtime name to a transport address (serial port, tcp: or unix:).
+// @options: assignment, baudRate, debugLevel, batchInterval (ms), maxQueued, handler
+var runDistributed = function(componentLib, graph, runtimes, options) {
+    options = options || {};
+    var names = Object.keys(runtimes);
+    var p = partitionGraph(graph, options.assignment, names[0]);
+    Object.keys(p.partitions).forEach(function(name) {
+        if (!runtimes[name]) {
+            throw "No address given for runtime: " + name;
+        }
+    });
+
+    var forwarders = {};
+    var handler = options.handler || function() {
+        console.log.apply(console, arguments);
+    };
+
+    var unsupported = {}; // packets that could not be forwarded, by runtime and type
+    var connect = function(name) {
+        var part = p.partitions[name] || { processes: {}, connections: [], exports: [] };
+        // Delta telemetry, so numbers keep their full width
+        var data = commandstream.cmdStreamFromGraph(componentLib, part, options.debugLevel, "delta");
+
+        serial.openTransport(runtimes[name], options.baudRate || 9600, function(err, transport) {
+            if (err) {
+                handler(name, "ERROR", err);
+                return;
+            }
+            forwarders[name] = new PacketForwarder(transport, options.maxQueued || 256);
+
+            var receive = function() {
+                var args = Array.prototype.slice.call(arguments);
+                if (args[0] === "NETSTART") {
+                    forwarders[name].headerSent = false;
+                    p.remoteEdges.forEach(function(e) {
+                        if (e.src === name) {
+                            forwarders[name].write(subscribeCommand(componentLib, part, e.edge.src.process, e.edge.src.port));
+                        }
+                    });
+                    forwarders[name].ready = true;
+                } else if (args[0] === "SEND" && part.processes[args[5]]
+                           && part.processes[args[5]].component === "RemoteOut") {
+                    var e = p.remoteEdges.filter(function(e) { return e.proxy === args[5] })[0];
+                    var target = forwarders[e.tgt];
+                    var type = cmdFormat.packetTypes[args[3]].id;
+                    if (type === cmdFormat.packetTypes.Float.id || type === cmdFormat.packetTypes.Ascii.id) {
+                        unsupported[name] = unsupported[name] || {};
+                        unsupported[name][args[3]] = (unsupported[name][args[3]] || 0) + 1;
+                    } else if (target) {
+                        var proxyId = p.partitions[e.tgt].nodeMap[e.proxy].id;
+                        target.push(proxyId, 0, type, args[4]);
+                    }
+                }
+                handler.apply(null, [name].concat(args));
+            };
+            runtime.uploadGraphBlocks(transport, data, part, receive, "fixed");
+        });
+    }
+    names.forEach(connect);
+
+    var interval = setInterval(function() {
+        Object.keys(forwarders).forEach(function(name) {
+            var f = forwarders[name];
+            f.flush();
+            if (f.dropped > 0) {
+                handler(name, "DROPPED", f.dropped);
+                f.dropped = 0;
+            }
+        });
+        Object.keys(unsupported).forEach(function(name) {
+            Object.keys(unsupported[name]).forEach(function(type) {
+                handler(name, "UNSUPPORTED", type, unsupported[name][type]);
+            });
+        });
+        unsupported = {};
+    }, options.batchInterval || 10);
+
+    return { partitions: p.partitions, remoteEdges: p.remoteEdges,
+             stop: function() { clearInterval(interval); } };
+}
+
+module.exports = {
+    partitionGraph: partitionGraph,
+    runDistributed: runDistributed,
+    PacketForwarder: PacketForwarder
+}
@@ -15,8 +15,12 @@ if (util.isBrowser()) {
 var cmdStreamToCDefinition = function(cmdStream, target) {
     var out = "";
     if (target === 'arduino' || target === 'avr') {
+        // Flash is scarce, decoded by loadEmbeddedGraph()
         out += "#include <avr/pgmspace.h>\n"
-        out += cmdStreamToC(cmdStream, "PROGMEM");
+        out += "#define MICROFLO_EMBED_GRAPH_COMPRESSED\n"
+        // Not at top, update-defs must work without dependencies installed
+        var commandstream = require("./commandstream");
+        out += cmdStreamToC(commandstream.compressCmdStream(cmdStream), "PROGMEM");
     } else {
         out += cmdStreamToC(cmdStream);
     }
@@ -115,6 +119,8 @@ var updateDefinitions = function(componentLib, baseDir) {
                  generateEnum("GraphCmd", "GraphCmd", cmdFormat.commands) +
                  "\n" + generateEnum("Msg", "Msg", cmdFormat.packetTypes) +
                  "\n" + generateEnum("DebugLevel", "DebugLevel", cmdFormat.debugLevels) +
+                 "\n" + generateEnum("SubscriptionMode", "SubscriptionMode", cmdFormat.subscriptionModes) +
+                 "\n" + generateEnum("TelemetryEncoding", "TelemetryEncoding", cmdFormat.telemetryEncodings) +
                  "\n" + generateEnum("DebugId", "Debug", cmdFormat.debugPoints));
 }
 
@@ -5,5 +5,7 @@ module.exports = {
     generate: require("./generate"),
     commandstream: require("./commandstream"),
     simulator: require("./simulator"),
-    serial: require("./serial")
+    serial: require("./serial"),
+    distributed: require("./distributed"),
+    stream: require("./stream")
 }
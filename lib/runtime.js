@@ -39,6 +39,9 @@ var generateOutput = function(componentLib, inputFile, outputFile, target) {
         fs.writeFile(outputBase + ".fbcs", data, function(err) {
             if (err) throw err;
         });
+        fs.writeFile(outputBase + ".fbgi", commandstream.graphImageFromCmdStream(data), function(err) {
+            if (err) throw err;
+        });
         fs.writeFile(outputBase + ".h", generate.cmdStreamToCDefinition(data, target), function(err) {
             if (err) throw err;
         });
@@ -70,13 +73,11 @@ var loadFile = function(filename, callback) {
 
 
 
-// TODO: allow port types to be declared in component metadata,
-// and send the appropriate types instead of just "all"
-// https://github.com/noflo/noflo/issues/51
+// Port types are declared in component metadata, untyped ports accept "all"
 var portDefAsArray = function(port) {
     var a = [];
     for (var name in port) {
-        a.push({id: name, type: "all"});
+        a.push({id: name, type: port[name].type || "all"});
     }
     return a;
 }
@@ -153,18 +154,59 @@ var parseReceivedCmd = function(cmdData, graph, handler) {
         var targetNode = nodeNameById(graph.nodeMap, cmdData.readUInt8(3))
         var targetPort = componentLib.inputPortById(nodeLookup(graph,targetNode).component, cmdData.readUInt8(4)).name
         handler("CONNECT", srcNode, srcPort, "->", targetPort, targetNode);
+    } else if (cmd == cmdFormat.commands.NodeRemoved.id) {
+        // Name was released when the removal was sent
+        handler("REMOVE", cmdData.readUInt8(1));
+    } else if (cmd == cmdFormat.commands.NodesDisconnected.id) {
+        var srcNode = nodeNameById(graph.nodeMap, cmdData.readUInt8(1))
+        var srcPort = srcNode ? componentLib.outputPortById(nodeLookup(graph, srcNode).component, cmdData.readUInt8(2)).name
+                              : cmdData.readUInt8(2);
+        handler("DISCONNECT", srcNode || cmdData.readUInt8(1), srcPort);
     } else if (cmd === cmdFormat.commands.DebugChanged.id) {
         var level = nodeNameById(cmdFormat.debugLevels, cmdData.readUInt8(1));
         handler("DEBUGLEVEL", level);
     } else if (cmd === cmdFormat.commands.DebugMessage.id) {
         var lvl = cmdData.readUInt8(1);
         var point = nodeNameById(cmdFormat.debugPoints, cmdData.readUInt8(2))
-        handler("DEBUG", lvl, point);
+        // Repeats are coalesced by device: how many, and time of first in ms (24 bit)
+        var count = cmdData.readUInt16LE(3);
+        var time = cmdData.readUInt16LE(5) + (cmdData.readUInt8(7) << 16);
+        handler("DEBUG", lvl, point, count, time);
     } else if (cmd === cmdFormat.commands.PortSubscriptionChanged.id) {
         var node = nodeNameById(graph.nodeMap, cmdData.readUInt8(1))
         var port = componentLib.outputPortById(graph.processes[node].component, cmdData.readUInt8(2)).name
         var enable = cmdData.readUInt8(3) ? "true" : "false";
+        var slot = cmdData.readUInt8(5);
+        if (slot !== 255) {
+            graph.subscriptionSlots = graph.subscriptionSlots || {};
+            graph.subscriptionSlots[slot] = { node: node, port: port };
+        }
         handler("SUBSCRIBE", node, "->", port, enable);
+    } else if (cmd === cmdFormat.commands.TelemetryChanged.id) {
+        var encoding = nodeNameById(cmdFormat.telemetryEncodings, cmdData.readUInt8(1));
+        handler("TELEMETRY", encoding, cmdData.readUInt8(2));
+    } else if (cmd === cmdFormat.commands.TelemetryChannel.id) {
+        graph.telemetryChannels = graph.telemetryChannels || {};
+        graph.telemetryChannels[cmdData.readUInt8(1)] = {
+            srcNode: nodeNameById(graph.nodeMap, cmdData.readUInt8(2)), srcPort: cmdData.readUInt8(3),
+            targetNode: nodeNameById(graph.nodeMap, cmdData.readUInt8(4)), targetPort: cmdData.readUInt8(5)
+        };
+    } else if (cmd === cmdFormat.commands.TelemetryData.id) {
+        graph.telemetryChannels = graph.telemetryChannels || {};
+        commandstream.decodeTelemetry(cmdData, graph.telemetryChannels).forEach(function(record) {
+            var c = graph.telemetryChannels[record.channel];
+            if (!c.srcNode) {
+                return; // Channel announcement was lost
+            }
+            var srcPort = componentLib.outputPortById(nodeLookup(graph, c.srcNode).component, c.srcPort).name
+            var targetPort = componentLib.inputPortById(nodeLookup(graph, c.targetNode).component, c.targetPort).name
+            var type = nodeNameById(cmdFormat.packetTypes, record.type);
+            handler("SEND", c.srcNode, srcPort, type, record.data, c.targetNode, targetPort);
+        });
+    } else if (cmd === cmdFormat.commands.PortSummary.id) {
+        var sub = (graph.subscriptionSlots || {})[cmdData.readUInt8(1)] || {};
+        handler("SUMMARY", sub.node, sub.port, cmdData.readInt16LE(2),
+                cmdData.readInt16LE(4), cmdData.readInt16LE(6));
     } else if (cmd === cmdFormat.commands.PacketSent.id) {
         var srcNode = nodeNameById(graph.nodeMap, cmdData.readUInt8(1))
         var srcPort = componentLib.outputPortById(nodeLookup(graph, srcNode).component, cmdData.readUInt8(2)).name
@@ -183,6 +225,23 @@ var parseReceivedCmd = function(cmdData, graph, handler) {
         }
 
         handler("SEND", srcNode, srcPort, type, data, targetNode, targetPort);
+    } else if (cmd === cmdFormat.commands.StackUsage.id) {
+        var free = cmdData.readInt32LE(1);
+        handler("STACK", free >= 0 ? free : "unsupported");
+    } else if (cmd === cmdFormat.commands.UploadReady.id) {
+        handler("UPLOADREADY", cmdData.readUInt8(1), cmdData.readUInt8(2));
+    } else if (cmd === cmdFormat.commands.UploadBlockAck.id) {
+        handler("UPLOADACK", cmdData.readUInt8(1), cmdData.readUInt8(2) ? true : false);
+    } else if (cmd === cmdFormat.commands.UploadVerified.id) {
+        handler("UPLOADVERIFIED", cmdData.readUInt8(1) ? true : false);
+    } else if (cmd === cmdFormat.commands.TelemetryDropped.id) {
+        handler("DROPPED", cmdData.readUInt16LE(1));
+    } else if (cmd === cmdFormat.commands.StreamOpened.id) {
+        // Window 0 means the stream could not be opened
+        handler("STREAMOPEN", cmdData.readUInt8(1), nodeNameById(graph.nodeMap, cmdData.readUInt8(2)),
+                cmdData.readUInt8(3), cmdData.readUInt8(4));
+    } else if (cmd === cmdFormat.commands.StreamCredit.id) {
+        handler("CREDIT", cmdData.readUInt8(1), cmdData.readUInt8(2));
     } else if (cmd === cmdFormat.commands.SubgraphPortConnected.id) {
         var direction = cmdData.readUInt8(1) ? "output" : "input";
         var portById = direction === "output" ? componentLib.outputPortById : componentLib.inputPortById
@@ -196,30 +255,72 @@ var parseReceivedCmd = function(cmdData, graph, handler) {
     }
 }
 
-var uploadGraph = function(transport, data, graph, receiveHandler) {
+// Device answers using the same framing as the commands it receives
+var listenToDevice = function(transport, graph, receiveHandler, compact) {
 
     var cmdSize = cmdFormat.commandSize;
     var buf = new Buffer(cmdSize*10);
     var offset = 0;
 
+    // Sockets can deliver much more at once than serial
+    var append = function(da) {
+        if (offset + da.length > buf.length) {
+            buf = Buffer.concat([buf.slice(0, offset), da]);
+        } else {
+            da.copy(buf, offset, 0, da.length);
+        }
+        offset += da.length;
+    }
+
     var onData = function(da) {
         // console.log("buf= ", buf.slice(0, offset));
         // console.log("data= ", da);
-        da.copy(buf, offset, 0, da.length);
-        offset += da.length;
+        append(da);
 
         for (var startIdx=0; startIdx < Math.floor(offset/cmdSize)*cmdSize; startIdx+=cmdSize) {
             var b = buf.slice(startIdx, startIdx+cmdSize);
             // console.log("b= ", b);
-            parseReceivedCmd(b, graph, receiveHandler ? receiveHandler : printReceived);
+            parseReceivedCmd(b, graph, receiveHandler);
         }
         var slush = offset % cmdSize;
         buf.copy(buf, 0, offset-slush, offset);
         offset = slush;
     };
 
+    var onCompactData = function(da) {
+        append(da);
+
+        var frameStart = 0;
+        for (var i=0; i<offset; i++) {
+            if (buf[i] !== 0) {
+                continue;
+            }
+            if (i > frameStart) {
+                var cmd = undefined;
+                try {
+                    cmd = commandstream.cobsDecode(buf.slice(frameStart, i));
+                } catch (err) {
+                    console.log("WARN: dropped invalid frame from device", err);
+                }
+                if (cmd) {
+                    parseReceivedCmd(cmd, graph, receiveHandler);
+                }
+            }
+            frameStart = i+1;
+        }
+        buf.copy(buf, 0, frameStart, offset);
+        offset -= frameStart;
+    };
+
     transport.removeAllListeners("data");
-    transport.on("data", onData);
+    transport.on("data", compact ? onCompactData : onData);
+}
+
+var uploadGraph = function(transport, data, graph, receiveHandler) {
+
+    var cmdSize = cmdFormat.commandSize;
+    listenToDevice(transport, graph, receiveHandler ? receiveHandler : printReceived,
+                   commandstream.isCompactStream(data));
 
     if (graph.uploadInProgress) {
         // avoid multiple uploads happening at same time
@@ -257,6 +358,117 @@ var uploadGraph = function(transport, data, graph, receiveHandler) {
      }, initialWait);
 }
 
+// Upload in CRC checked blocks, keeping as many in flight as device can buffer.
+// Blocks are resent when device reports them corrupt, or no ack arrives in time.
+// @data is a command stream with fixed framing, @framing is used for commands outside the upload
+var uploadGraphBlocks = function(transport, data, graph, receiveHandler, framing) {
+    var handler = receiveHandler ? receiveHandler : printReceived;
+    var begin = applyFraming(commandstream.beginUploadStream(data), framing);
+    var image = data.slice(cmdFormat.magicString.length);
+    var ackTimeout = transport.getTransportType() === "HostJavaScript" ? 10 : 500;
+    var maxRetries = 10;
+
+    var blocks = [];
+    var acked = [];
+    var windowSize = 0;
+    var base = 0; // first block not acked
+    var next = 0; // next block not sent
+    var endSent = false;
+    var retries = 0;
+    var timer = undefined;
+
+    var sendBlock = function(index) {
+        if (index === blocks.length) {
+            endSent = true;
+            transport.write(commandstream.uploadBlock(index, new Buffer(0), commandstream.crc16(image)));
+        } else {
+            transport.write(commandstream.uploadBlock(index, blocks[index]));
+        }
+    }
+    var fillWindow = function() {
+        while (next < blocks.length && next < base+windowSize) {
+            sendBlock(next++);
+        }
+        if (base === blocks.length && !endSent) {
+            sendBlock(blocks.length);
+        }
+    }
+    var finish = function() {
+        clearTimeout(timer);
+        graph.uploadInProgress = false;
+    }
+    var restartTimer = function() {
+        clearTimeout(timer);
+        timer = setTimeout(function() {
+            if (++retries > maxRetries) {
+                finish();
+                handler("UPLOAD", "failed", "no response from device");
+                return;
+            }
+            for (var i=base; i<next; i++) {
+                if (!acked[i]) {
+                    sendBlock(i);
+                }
+            }
+            if (endSent) {
+                sendBlock(blocks.length);
+            }
+            restartTimer();
+        }, ackTimeout);
+    }
+
+    var onReply = function(type) {
+        if (type === "UPLOADREADY") {
+            windowSize = arguments[1];
+            var blockSize = arguments[2];
+            for (var i=0; i<image.length; i+=blockSize) {
+                blocks.push(image.slice(i, i+blockSize));
+            }
+            fillWindow();
+            restartTimer();
+        } else if (type === "UPLOADACK") {
+            var index = base + ((arguments[1] - base) & 0xFF);
+            if (index >= next) {
+                // Ack for a block not in flight, or corrupted sequence number
+                return;
+            }
+            if (arguments[2]) {
+                acked[index] = true;
+                retries = 0;
+            } else {
+                sendBlock(index);
+            }
+            while (acked[base]) {
+                base++;
+            }
+            fillWindow();
+            restartTimer();
+        } else if (type === "UPLOADVERIFIED") {
+            finish();
+            handler("UPLOAD", arguments[1] ? "verified" : "failed");
+        } else {
+            handler.apply(this, arguments);
+        }
+    }
+
+    listenToDevice(transport, graph, onReply, commandstream.isCompactStream(begin));
+
+    if (graph.uploadInProgress) {
+        console.log("WARN: Graph upload in progress, ignored second attempt");
+        return;
+    }
+    graph.uploadInProgress = true;
+    transport.write(begin);
+}
+
+var deployGraph = function(transport, data, graph, receiveHandler, framing, uploadMode) {
+    if (uploadMode === "blocks") {
+        uploadGraphBlocks(transport, data, graph, receiveHandler, framing);
+    } else {
+        uploadGraph(transport, applyFraming(data, framing), graph, receiveHandler);
+    }
+}
+
 var listComponents = function(connection) {
     for (var name in componentLib.getComponents()) {
         var comp = componentLib.getComponent(name);
@@ -280,7 +492,24 @@ var handleComponentCommand = function(command, payload, connection) {
     }
 }
 
-var handleGraphCommand = function(command, payload, connection, graph) {
+// Changes the running network too, if any, instead of waiting for next upload
+var handleGraphCommand = function(command, payload, connection, graph, transport, framing) {
+    var liveCommands = ["addnode", "removenode", "addedge", "removeedge", "addinitial"];
+    if (graph.running && transport && liveCommands.indexOf(command) !== -1) {
+        var change = (command === "addnode" || command === "removenode") ? payload : wsConnectionFormatToFbp(payload);
+        try {
+            var cmd = commandstream.graphChangeCommands(componentLib, graph, command, change);
+            var magic = new Buffer(cmdFormat.commandSize);
+            commandstream.writeString(magic, 0, cmdFormat.magicString);
+            if (cmd.length) {
+                transport.write(applyFraming(Buffer.concat([magic, cmd]), framing));
+            }
+        } catch (err) {
+            var msg = {protocol: 'network', command: 'output', payload: {message: "ERROR: " + err}};
+            connection.send(msg);
+        }
+    }
+
     if (command == "clear") {
         graph.processes = {};
         graph.connections = [];
@@ -301,7 +530,57 @@ var handleGraphCommand = function(command, payload, connection, graph) {
     }
 }
 
-var handleNetworkStartStop = function (graph, connection, transport, debugLevel) {
+var applyFraming = function(cmdStream, framing) {
+    if (framing === "compact") {
+        return commandstream.toCompactStream(cmdStream);
+    }
+    return cmdStream;
+}
+
+// Collects edge data messages, and sends them at most @latency ms later as one WebSocket frame:
+// an array of the network:data messages, unchanged and in the order device sent them.
+// A single message is sent as it is
+var EdgeDataBatcher = function(send, latency) {
+    this.send = send;
+    this.latency = latency;
+    this.messages = [];
+    this.timer = undefined;
+}
+
+EdgeDataBatcher.prototype.push = function(msg) {
+    this.messages.push(msg);
+
+    if (!this.timer) {
+        var self = this;
+        this.timer = setTimeout(function() {
+            self.flush();
+        }, this.latency);
+    }
+}
+
+EdgeDataBatcher.prototype.flush = function() {
+    clearTimeout(this.timer);
+    this.timer = undefined;
+    var messages = this.messages;
+    this.messages = [];
+    if (messages.length == 1) {
+        this.send(messages[0]);
+    } else if (messages.length > 1) {
+        this.send(messages);
+    }
+}
+
+var handleNetworkStartStop = function (graph, connection, transport, debugLevel, framing, uploadMode, telemetry,
+                                       batchLatency) {
+    // Edge data goes out as it arrives, unless batching is on
+    var batcher = batchLatency ? new EdgeDataBatcher(connection.send, batchLatency) : undefined;
+    var sendData = function(msg) {
+        if (batcher) {
+            batcher.push(msg);
+        } else {
+            connection.send(msg);
+        }
+    }
 
     // FIXME: also do error handling, and send that across
     // https://github.com/noflo/noflo-runtime-websocket/blob/master/runtime/network.js
@@ -311,6 +590,10 @@ var handleNetworkStartStop = function (graph, connection, transport, debugLevel)
         for (var i=0; i<arguments.length; i++) {
             args.push(arguments[i]);
         }
+        if (batcher && args[0] != "SEND" && args[0] != "SUMMARY") {
+            // UI must see data sent before other messages first
+            batcher.flush();
+        }
         if (args[0] == "SEND") {
             var data = undefined;
             if (args[3] == "Void") {
@@ -324,12 +607,29 @@ var handleNetworkStartStop = function (graph, connection, transport, debugLevel)
                     data: data
                 }
             }
-            connection.send(msg);
+            sendData(msg);
+
+        } else if (args[0] == "SUMMARY") {
+            var tgt = {};
+            graph.connections.forEach(function(edge) {
+                if (edge.src && edge.src.process === args[1] && edge.src.port === args[2]) {
+                    tgt = {node: edge.tgt.process, port: edge.tgt.port};
+                }
+            });
+            var msg = {protocol: "network", command: "data", payload: {
+                    src: {node: args[1], port: args[2]},
+                    tgt: tgt,
+                    data: {min: args[3], max: args[4], mean: args[5]}
+                }
+            }
+            sendData(msg);
 
         } else if (args[0] == "NETSTOP") {
+            graph.running = false;
             var m = {protocol: "network", command: "stopped"};
             connection.send(m);
         } else if (args[0] == "NETSTART") {
+            graph.running = true;
             var m = {protocol: "network", command: "started"};
             connection.send(m);
         } else {
@@ -340,12 +640,13 @@ var handleNetworkStartStop = function (graph, connection, transport, debugLevel)
         }
     }
 
-    var data = commandstream.cmdStreamFromGraph(componentLib, graph, debugLevel);
-    uploadGraph(transport, data, graph, wsSendOutput);
+    var data = commandstream.cmdStreamFromGraph(componentLib, graph, debugLevel, telemetry);
+    deployGraph(transport, data, graph, wsSendOutput, framing, uploadMode);
 
 }
 
-var handleNetworkEdges = function (graph, connection, transport, edges) {
+var handleNetworkEdges = function (graph, connection, transport, edges, framing, subscription) {
+    var mode = commandstream.parseSubscriptionMode(subscription);
 
     // Loop over all edges, unsubscribe
     graph.connections.forEach(function(edge) {
@@ -356,7 +657,7 @@ var handleNetworkEdges = function (graph, connection, transport, edges) {
             var buffer = new Buffer(16);
             commandstream.writeString(buffer, 0, cmdFormat.magicString);
             commandstream.writeCmd(buffer, 8, cmdFormat.commands.SubscribeToPort.id, srcId, srcPort, 0);
-            transport.write(buffer);
+            transport.write(applyFraming(buffer, framing));
         }
     });
 
@@ -367,24 +668,27 @@ var handleNetworkEdges = function (graph, connection, transport, edges) {
         var srcPort = componentLib.outputPort(srcComp, edge.src.port).id;
         var buffer = new Buffer(16);
         commandstream.writeString(buffer, 0, cmdFormat.magicString);
-        commandstream.writeCmd(buffer, 8, cmdFormat.commands.SubscribeToPort.id, srcId, srcPort, 1);
-        transport.write(buffer);
+        commandstream.writeCmd(buffer, 8, cmdFormat.commands.SubscribeToPort.id, srcId, srcPort, 1,
+                               mode.id, mode.param & 0xFF, mode.param >> 8);
+        transport.write(applyFraming(buffer, framing));
     });
 }
 
-var handleNetworkCommand = function(command, payload, connection, graph, transport, debugLevel) {
+var handleNetworkCommand = function(command, payload, connection, graph, transport, debugLevel, framing, uploadMode,
+                                    subscription, telemetry, batchLatency) {
     if (command == "start" || command == "stop") {
         // TODO: handle stop command separately, actually pause the graph
-        handleNetworkStartStop(graph, connection, transport, debugLevel)
+        handleNetworkStartStop(graph, connection, transport, debugLevel, framing, uploadMode, telemetry, batchLatency)
     } else if (command == "edges"){
         // FIXME: should not need to use transport directly here
-        handleNetworkEdges(graph, connection, transport, payload.edges)
+        handleNetworkEdges(graph, connection, transport, payload.edges, framing, subscription)
     } else {
         console.log("Unknown NoFlo UI command on protocol 'network':", command, payload);
     }
 }
 
-var handleMessage = function (message, wsConnection, graph, getTransport, debugLevel) {
+var handleMessage = function (message, wsConnection, graph, getTransport, debugLevel, framing, uploadMode,
+                              subscription, telemetry, batchLatency) {
   if (message.type == 'utf8') {
     try {
       var contents = JSON.parse(message.utf8Data);
@@ -404,10 +708,11 @@ var handleMessage = function (message, wsConnection, graph, getTransport, debugL
         handleComponentCommand(contents.command, contents.payload, connection);
     } else if (contents.protocol == "graph") {
         handleGraphCommand(contents.command, contents.payload, connection,
-                                graph);
+                                graph, transport, framing);
     } else if (contents.protocol == "network") {
         handleNetworkCommand(contents.command, contents.payload, connection,
-                                graph, transport, debugLevel);
+                                graph, transport, debugLevel, framing, uploadMode, subscription, telemetry,
+                                batchLatency);
     } else {
         console.log("Unknown NoFlo UI protocol:", contents);
     }
@@ -435,7 +740,8 @@ var registerRuntime = function(rtinfo, regoptions) {
 
 }
 
-var setupRuntime = function(serialPortToUse, baudRate, port, debugLevel, ip, register) {
+var setupRuntime = function(serialPortToUse, baudRate, port, debugLevel, ip, register, framing, uploadMode,
+                            subscription, telemetry, batchLatency) {
 
     var httpServer = http.createServer(function(request, response) {
         var path = url.parse(request.url).pathname
@@ -458,7 +764,8 @@ var setupRuntime = function(serialPortToUse, baudRate, port, debugLevel, ip, reg
     wsServer.on('request', function (request) {
         var connection = request.accept('noflo', request.origin);
         connection.on('message', function (message) {
-            handleMessage(message, connection, graph, getSerial, debugLevel);
+            handleMessage(message, connection, graph, getSerial, debugLevel, framing, uploadMode, subscription, telemetry,
+                          batchLatency);
         });
     });
 
@@ -492,12 +799,23 @@ var setupRuntime = function(serialPortToUse, baudRate, port, debugLevel, ip, reg
     });
 }
 
-var uploadGraphFromFile = function(graphPath, serialPortName, baudRate, debugLevel) {
+// With @stackAlarm, device is asked for its stack usage once the graph runs, see queryStackUsageCommand()
+var uploadGraphFromFile = function(graphPath, serialPortName, baudRate, debugLevel, framing, uploadMode, stackAlarm) {
 
     serial.openTransport(serialPortName, baudRate, function (err, transport) {
         loadFile(graphPath, function(err, graph) {
             var data = commandstream.cmdStreamFromGraph(componentLib, graph, debugLevel);
-            uploadGraph(transport, data, graph);
+            var handler = printReceived;
+            if (typeof stackAlarm !== 'undefined') {
+                handler = function(type) {
+                    printReceived.apply(this, arguments);
+                    if (type === "NETSTART") {
+                        var query = commandstream.queryStackUsageCommand(stackAlarm);
+                        transport.write(applyFraming(query, framing));
+                    }
+                }
+            }
+            deployGraph(transport, data, graph, handler, framing, uploadMode);
         });
     });
 }
@@ -508,5 +826,7 @@ module.exports = {
     setupRuntime: setupRuntime,
     uploadGraphFromFile: uploadGraphFromFile,
     uploadGraph: uploadGraph,
+    uploadGraphBlocks: uploadGraphBlocks,
+    EdgeDataBatcher: EdgeDataBatcher,
 }
 
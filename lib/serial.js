@@ -4,6 +4,7 @@
  */
 
 var serialport = require("serialport");
+var net = require("net");
 
 var isLikelyArduinoSerial = function (e) {
     return e.comName.indexOf("usbserial") !== -1 || e.comName.indexOf("usbmodem") !== -1
@@ -43,7 +44,42 @@ var guessSerialPort = function(wantedPortName, callback) {
 }
 
 
+// Linux runtime listens on "tcp:[HOST:]PORT" or "unix:PATH" instead of a serial port
+var isSocketAddress = function(address) {
+    return address && (address.indexOf("tcp:") === 0 || address.indexOf("unix:") === 0);
+}
+
+var getSocket = function(address, cb) {
+    var options = undefined;
+    if (address.indexOf("unix:") === 0) {
+        options = { path: address.slice(5) };
+    } else {
+        var parts = address.slice(4).split(":");
+        options = parts.length > 1 ? { host: parts[0], port: parseInt(parts[1]) } : { port: parseInt(parts[0]) };
+    }
+    console.log("Using socket: " + address);
+    var done = function(err, socket) {
+        if (cb) {
+            cb(err, socket);
+        }
+        cb = undefined;
+    }
+    var socket = net.connect(options, function() {
+        done(undefined, socket);
+    });
+    socket.on("error", function(err) {
+        console.log("Socket error: ", err.toString());
+        done(err, undefined);
+    });
+    socket.setNoDelay(true);
+    socket.getTransportType = function () { return "Socket"; }
+    return function() { return socket };
+}
+
 var getSerial = function(serialPortToUse, baudRate, cb) {
+    if (isSocketAddress(serialPortToUse)) {
+        return getSocket(serialPortToUse, cb);
+    }
     console.log("Using serial baudrate", baudRate);
     var serial = undefined;
     guessSerialPort(serialPortToUse, function(err, portName, ports) {
@@ -54,19 +54,16 @@ function JsTransport(network) {
     this.hosttransport = new addon.HostTransport();
     network.setTransport(this.hosttransport);
 
+    // Input since last tick is parsed in one go, and output arrives as one Buffer per tick
     this.hosttransport.on("_pull", function(j) {
-        for (var i=0; i<self.outbound_queue.length; i++) {
-            var buffer = self.outbound_queue[i];
-            for (var j=0; j<buffer.length; j++) {
-                var byte = buffer.readUInt8(j);
-                self.hosttransport.send(byte);
-            }
+        if (self.outbound_queue.length > 0) {
+            self.hosttransport.send(Buffer.concat(self.outbound_queue));
+            self.outbound_queue = [];
         }
-        self.outbound_queue = [];
     });
-    this.hosttransport.on("_receive", function (byte) {
-        //console.log("_receive", byte);
-        self.emit("data", new Buffer([byte]))
+    this.hosttransport.on("_receive", function (buffer) {
+        //console.log("_receive", buffer);
+        self.emit("data", buffer)
     });
     this.getTransportType = function () { return "HostJavaScript"; }
 }
@@ -0,0 +1,133 @@
+/* MicroFlo - Flow-Based Programming for microcontrollers
+ * Copyright (c) 2014 Jon Nordby <jononor@gmail.com>
+ * MicroFlo may be freely distributed under the MIT license
+ */
+
+// Streaming packets from host into one input port of a running graph.
+// Device grants a window of packets when the stream is opened, and gives credit
+// back as the packets are delivered. Host never has more than the window in flight,
+// so nothing is dropped on the device side however fast the host produces.
+
+var commandstream = require("./commandstream");
+var cmdFormat = require("./commandformat");
+
+// Writes to stream @stream, bound to input @port of node @tgt, on @transport.
+// Call handle() with everything received from device.
+// @options: type (packet type id, default Integer), window (0: as much as device can take),
+// timeout (ms without credit before reopening), maxQueued
+var StreamWriter = function(transport, stream, tgt, port, options) {
+    options = options || {};
+    this.transport = transport;
+    this.stream = stream;
+    this.tgt = tgt;
+    this.port = port;
+    this.type = options.type || cmdFormat.packetTypes.Integer.id;
+    this.window = options.window || 0;
+    this.timeout = options.timeout || 1000;
+    this.maxQueued = options.maxQueued || 4096;
+    this.queue = [];
+    this.credits = 0;
+    this.granted = 0; // window given by device, 0 while not open
+    this.sent = 0;
+    this.congested = false;
+    this.headerSent = false;
+    this.timer = undefined;
+    this.onError = function() {};
+
+    var self = this;
+    if (transport.on) {
+        transport.on("drain", function() {
+            self.congested = false;
+            self.flush();
+        });
+    }
+}
+
+StreamWriter.prototype.open = function() {
+    this.granted = 0;
+    this.credits = 0;
+    this.write(commandstream.openStreamCommand(this.stream, this.tgt, this.port, this.window));
+    this.restartTimer();
+}
+
+// Returns false if the queue is full and @value was not taken
+StreamWriter.prototype.push = function(value) {
+    if (this.queue.length >= this.maxQueued) {
+        return false;
+    }
+    this.queue.push(value);
+    this.flush();
+    return true;
+}
+
+// Packets sent but not yet delivered on device
+StreamWriter.prototype.inFlight = function() {
+    return this.granted - this.credits;
+}
+
+StreamWriter.prototype.flush = function() {
+    while (this.granted && !this.congested && this.credits > 0 && this.queue.length > 0) {
+        var values = this.queue.splice(0, Math.min(this.credits, 255));
+        this.credits -= values.length;
+        this.sent += values.length;
+        this.write(commandstream.streamDataCommand(this.stream, this.type, values));
+        this.restartTimer();
+    }
+}
+
+// Takes the arguments a runtime receive handler gets
+StreamWriter.prototype.handle = function(type, stream) {
+    if (stream !== this.stream) {
+        return;
+    }
+    if (type === "STREAMOPEN") {
+        var window = arguments[4];
+        if (window === 0) {
+            clearTimeout(this.timer);
+            this.onError("Device could not open stream " + stream);
+            return;
+        }
+        this.granted = window;
+        this.credits = window;
+    } else if (type === "CREDIT") {
+        this.credits = Math.min(this.credits + arguments[2], this.granted);
+    } else {
+        return;
+    }
+    this.restartTimer();
+    this.flush();
+}
+
+StreamWriter.prototype.close = function() {
+    clearTimeout(this.timer);
+    this.granted = 0;
+}
+
+// A lost credit would stall the stream for good. Reopening resets the window on both sides
+StreamWriter.prototype.restartTimer = function() {
+    var self = this;
+    clearTimeout(this.timer);
+    if (this.granted && this.inFlight() === 0 && this.queue.length === 0) {
+        return;
+    }
+    this.timer = setTimeout(function() {
+        self.open();
+    }, this.timeout);
+}
+
+// Device is waiting for the magic string after graph upload, but takes it as a command later
+StreamWriter.prototype.write = function(commands) {
+    if (!this.headerSent) {
+        var magic = new Buffer(cmdFormat.commandSize);
+        commandstream.writeString(magic, 0, cmdFormat.magicString);
+        commands = Buffer.concat([magic, commands]);
+        this.headerSent = true;
+    }
+    if (this.transport.write(commands) === false) {
+        this.congested = true;
+    }
+}
+
+module.exports = {
+    StreamWriter: StreamWriter
+}
@@ -5,12 +5,14 @@
 
 #include <node.h>
 #include <v8.h>
+#include <node_buffer.h>
 
 #define HOST_BUILD
 #define MICROFLO_NO_MAIN
 #include "microflo/microflo.hpp"
 
 #include <string>
+#include <vector>
 
 // Packet
 v8::Handle<v8::Value> PacketToJsObject(const Packet &p) {
@@ -246,8 +248,12 @@ v8::Handle<v8::Value> JavaScriptComponent::Send(const v8::Arguments& args) {
 
 
 // HostTransport
+// Outgoing bytes are collected, and handed to JavaScript as one Buffer per tick.
+// Calling into V8 for each byte made simulated uploads slow
 class JavaScriptHostTransport : public node::ObjectWrap, public HostTransport  {
 public:
+    JavaScriptHostTransport();
+
     // implements HostTransport
     virtual void setup(IO *i, HostCommunication *c);
     virtual void runTick();
@@ -256,6 +262,8 @@ public:
     static void Init(v8::Handle<v8::Object> exports);
 
 private:
+    void flushOutput();
+
     static v8::Handle<v8::Value> New(const v8::Arguments& args);
     static v8::Handle<v8::Value> On(const v8::Arguments& args);
     static v8::Handle<v8::Value> Send(const v8::Arguments& args);
@@ -263,27 +271,58 @@ private:
 
 private:
     HostCommunication *controller;
+    std::vector<uint8_t> output;
     v8::Persistent<v8::Function> receiveFunc;
     v8::Persistent<v8::Function> pullFunc;
 };
 
+JavaScriptHostTransport::JavaScriptHostTransport()
+    : controller(0)
+{
+    output.reserve(1024);
+}
+
 void JavaScriptHostTransport::setup(IO *i, HostCommunication *c) {
     controller = c;
 }
 
 void JavaScriptHostTransport::runTick() {
+    controller->flushTelemetry();
     const int argc = 0;
     v8::Local<v8::Value> argv[argc] = {
 
     };
     pullFunc->Call(v8::Context::GetCurrent()->Global(), argc, argv);
+    // Debug messages are only queued by the network, like the other transports send them after input
+    controller->flushDebug();
+    flushOutput();
 }
 
 void JavaScriptHostTransport::sendCommandByte(uint8_t b) {
+    output.push_back(b);
+}
+
+// Replies to input, and everything the network sent since last tick, in one Buffer
+void JavaScriptHostTransport::flushOutput() {
+    if (output.empty() || receiveFunc.IsEmpty()) {
+        return;
+    }
+    v8::HandleScope scope;
+    node::Buffer *slowBuffer = node::Buffer::New((const char *)&output[0], output.size());
+
+    // Wrap in a regular Buffer, so that JavaScript can slice and concat it
+    v8::Local<v8::Function> bufferConstructor = v8::Local<v8::Function>::Cast(
+                v8::Context::GetCurrent()->Global()->Get(v8::String::NewSymbol("Buffer")));
+    v8::Handle<v8::Value> bufferArgs[3] = {
+        slowBuffer->handle_,
+        v8::Integer::New(output.size()),
+        v8::Integer::New(0)
+    };
+    output.clear();
 
     const int argc = 1;
     v8::Local<v8::Value> argv[argc] = {
-        v8::Local<v8::Value>::New(v8::Number::New(b)),
+        bufferConstructor->NewInstance(3, bufferArgs),
     };
     receiveFunc->Call(v8::Context::GetCurrent()->Global(), argc, argv);
 }
@@ -331,8 +370,16 @@ v8::Handle<v8::Value> JavaScriptHostTransport::Send(const v8::Arguments& args) {
   v8::HandleScope scope;
 
   JavaScriptHostTransport* obj = node::ObjectWrap::Unwrap<JavaScriptHostTransport>(args.This());
-  const uint8_t b = args[0]->Int32Value();
-  if (obj->controller) {
+  if (!obj->controller) {
+      return scope.Close(v8::Undefined());
+  }
+  // Whole Buffers go to the bulk parser, single bytes are still accepted
+  if (node::Buffer::HasInstance(args[0])) {
+      v8::Local<v8::Object> buffer = args[0]->ToObject();
+      obj->controller->parseBytes((const uint8_t *)node::Buffer::Data(buffer),
+                                  node::Buffer::Length(buffer));
+  } else {
+      const uint8_t b = args[0]->Int32Value();
       obj->controller->parseByte(b);
   }
 
@@ -24,16 +24,145 @@ var setupRuntimeCommand = function(env) {
     var ip = env.parent.ip || "127.0.0.1"
     var reg = env.parent.registry || ""
     var baud = parseInt(env.parent.baudrate) || 9600
-
-    microflo.runtime.setupRuntime(serialPortToUse, baud, port, debugLevel, ip, reg);
+    var framing = env.parent.framing || "fixed"
+    var uploadMode = env.parent.upload || "stream"
+    var subscription = env.parent.subscribe || "all"
+    var telemetry = env.parent.telemetry || "packet"
+    var batchLatency = parseInt(env.parent.batch) || 0
+
+    microflo.runtime.setupRuntime(serialPortToUse, baud, port, debugLevel, ip, reg, framing, uploadMode,
+                                  subscription, telemetry, batchLatency);
 }
 
 var uploadGraphCommand = function(graphPath, env) {
     var serialPortName = env.parent.serial || "auto";
     var debugLevel = env.parent.debug
     var baud = parseInt(env.parent.baudrate) || 9600
+    var framing = env.parent.framing || "fixed"
+    var uploadMode = env.parent.upload || "stream"
+    var stackAlarm = (typeof env.parent.stack !== 'undefined') ? parseInt(env.parent.stack) || 0 : undefined
+
+    microflo.runtime.uploadGraphFromFile(graphPath, serialPortName, baud, debugLevel, framing, uploadMode,
+                                         stackAlarm);
+}
+
+// "a=x,b=y" -> {a: "x", b: "y"}
+var parseMapping = function(str) {
+    var mapping = {};
+    (str || "").split(",").forEach(function(pair) {
+        var i = pair.indexOf("=");
+        if (i > 0) {
+            mapping[pair.slice(0, i)] = pair.slice(i+1);
+        }
+    });
+    return mapping;
+}
+
+var distributeCommand = function(graphPath, env) {
+    var runtimes = parseMapping(env.parent.runtimes);
+    if (Object.keys(runtimes).length === 0) {
+        throw "No runtimes given, use --runtimes NAME=ADDRESS,..."
+    }
+    var options = {
+        assignment: parseMapping(env.parent.assign),
+        baudRate: parseInt(env.parent.baudrate) || 9600,
+        debugLevel: env.parent.debug
+    };
+    microflo.runtime.loadFile(graphPath, function(err, graph) {
+        if (err) throw err;
+        microflo.distributed.runDistributed(componentLib, graph, runtimes, options);
+    });
+}
+
+// Upload graph, then stream the values in a file to one input port, PROCESS.PORT
+var streamCommand = function(graphPath, target, valuesPath, env) {
+    var serialPortName = env.parent.serial || "auto";
+    var baud = parseInt(env.parent.baudrate) || 9600
+    var i = target.lastIndexOf(".");
+    var node = target.slice(0, i);
+    var portName = target.slice(i+1);
+    var values = require("fs").readFileSync(valuesPath, "utf8").split(/[\s,]+/).filter(function(v) {
+        return v.length > 0;
+    });
+
+    microflo.runtime.loadFile(graphPath, function(err, graph) {
+        if (err) throw err;
+        if (i <= 0 || !graph.processes[node]) {
+            throw "Unknown stream target: " + target;
+        }
+        var data = microflo.commandstream.cmdStreamFromGraph(componentLib, graph, env.parent.debug);
+        var port = componentLib.inputPort(graph.processes[node].component, portName);
+        if (!port) {
+            throw "Unknown port: " + target;
+        }
+        var boolean = port.type === "boolean";
+        var type = boolean ? cmdFormat.packetTypes.Boolean.id : cmdFormat.packetTypes.Integer.id;
+
+        microflo.serial.openTransport(serialPortName, baud, function(err, transport) {
+            if (err) throw err;
+            var writer = new microflo.stream.StreamWriter(transport, 0, graph.nodeMap[node].id, port.id,
+                                                          { type: type, maxQueued: values.length });
+            var start;
+            writer.onError = function(e) {
+                console.log("ERROR", e);
+            };
+            microflo.runtime.uploadGraphBlocks(transport, data, graph, function() {
+                var args = Array.prototype.slice.call(arguments);
+                if (args[0] === "NETSTART") {
+                    writer.headerSent = false;
+                    writer.open();
+                    values.forEach(function(v) {
+                        writer.push(boolean ? v === "true" : parseInt(v));
+                    });
+                    start = Date.now();
+                } else if (args[0] === "STREAMOPEN" || args[0] === "CREDIT") {
+                    writer.handle.apply(writer, args);
+                    if (writer.queue.length === 0 && writer.inFlight() === 0) {
+                        var seconds = (Date.now()-start)/1000;
+                        console.log("Streamed", writer.sent, "packets in", seconds, "s,",
+                                    Math.round(writer.sent/seconds), "packets/s");
+                        writer.close();
+                    }
+                } else {
+                    console.log(args.join(", "));
+                }
+            }, "fixed");
+        });
+    });
+}
 
-    microflo.runtime.uploadGraphFromFile(graphPath, serialPortName, baud, debugLevel);
+// Embedded graph size as plain commands and as compressed image, for given graphs or all examples
+var graphSizeCommand = function(env) {
+    var files = process.argv.slice(3);
+    if (files.length === 0) {
+        files = require("fs").readdirSync("examples").map(function(f) { return "examples/" + f; });
+    }
+    var pad = function(s, n) {
+        s = String(s);
+        return n < 0 ? s + new Array(-n-s.length+1).join(" ") : new Array(n-s.length+1).join(" ") + s;
+    };
+    console.log(pad("graph", -36) + pad("commands", 10) + pad("compressed", 12));
+    var next = function() {
+        var file = files.shift();
+        if (!file) {
+            return;
+        }
+        microflo.runtime.loadFile(file, function(err, graph) {
+            var line = pad(file, -36);
+            try {
+                if (err) throw err;
+                var data = microflo.commandstream.cmdStreamFromGraph(componentLib, graph);
+                var compressed = microflo.commandstream.compressCmdStream(data);
+                line += pad(data.length, 10) + pad(compressed.length, 12)
+                    + " (" + Math.round(100*compressed.length/data.length) + "%)";
+            } catch (e) {
+                line += "  error: " + e;
+            }
+            console.log(line);
+            next();
+        });
+    }
+    next();
 }
 
 var generateFwCommand = function(env) {
@@ -55,17 +184,40 @@ var main = function() {
         .option('-p, --port <PORT>', 'which port to use for WebSocket')
         .option('-i, --ip <IP>', 'which IP to use for WebSocket')
         .option('-r, --registry <URL>', 'Flowhub registry')
+        .option('-f, --framing <MODE>', 'host protocol framing: fixed (default) or compact')
+        .option('-u, --upload <MODE>', 'graph upload: stream (default) or blocks, with CRC and retransmit')
+        .option('-S, --subscribe <MODE>', 'edge data: all (default), every:N, rate:MS or summary:MS')
+        .option('-t, --telemetry <MODE>', 'edge data encoding: packet (default), or delta[:KEYFRAME_INTERVAL]')
+        .option('-B, --batch <MS>', 'edge data to NoFlo UI: one frame per MS with all messages (default: sent at once)')
+        .option('-R, --runtimes <LIST>', 'runtimes for distribute: NAME=ADDRESS,... First is default')
+        .option('-a, --assign <LIST>', 'processes to runtimes for distribute: PROCESS=NAME,...')
+        .option('-k, --stack <BYTES>', 'after upload, report free stack, and alarm when below BYTES (0: report only)')
 
     commander
         .command('generate')
         .description('Generate MicroFlo firmware code, with embedded graph.')
         .action(generateFwCommand);
 
+    commander
+        .command('graph-size')
+        .description('Compare size of embedded graph as commands and compressed, for given graphs or examples/')
+        .action(graphSizeCommand);
+
     commander
         .command('upload')
         .description('Upload a new graph to a device running MicroFlo firmware')
         .action(uploadGraphCommand);
 
+    commander
+        .command('distribute')
+        .description('Run a graph across several devices/runtimes, forwarding packets between them')
+        .action(distributeCommand);
+
+    commander
+        .command('stream')
+        .description('Upload a graph, then stream values from a file to PROCESS.PORT with flow control')
+        .action(streamCommand);
+
     commander
         .command('runtime')
         .description('Run as a server, for use with the NoFlo UI.')
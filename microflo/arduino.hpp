@@ -7,6 +7,10 @@
 
 #include "microflo.h"
 
+#ifdef __AVR__
+#include <avr/eeprom.h>
+#endif
+
 static const int MAX_EXTERNAL_INTERRUPTS = 3;
 
 struct InterruptHandler {
@@ -119,4 +123,26 @@ public:
             attachInterrupt(interrupt, externalInterrupt2, m);
         }
     }
+
+#ifdef __AVR__
+    // Storage
+    // All of EEPROM, see Avr8IO
+    virtual long StorageSize() {
+        return E2END+1;
+    }
+    virtual bool StorageErase(long offset, long length) {
+        uint8_t blank[8];
+        memset(blank, 0xFF, sizeof(blank));
+        eeprom_update_block(blank, (void *)(size_t)offset, sizeof(blank));
+        return true;
+    }
+    virtual bool StorageWrite(long offset, const uint8_t *data, uint8_t length) {
+        eeprom_update_block(data, (void *)(size_t)offset, length);
+        return true;
+    }
+    virtual bool StorageRead(long offset, uint8_t *data, uint8_t length) {
+        eeprom_read_block(data, (const void *)(size_t)offset, length);
+        return true;
+    }
+#endif
 };
@@ -6,6 +6,7 @@
 #include "microflo.h"
 
 #include <avr/io.h>
+#include <avr/eeprom.h>
 #include <util/atomic.h>
 
 // Datasheets
@@ -49,6 +50,33 @@ static const AvrPort ports[6] = {
 
 static volatile long g_millis = 0;
 
+// Stack painting, see
+// http://www.avrfreaks.net/index.php?name=PNphpBB2&file=viewtopic&t=52249
+// Fill the RAM between static data and the top of stack with a canary before
+// anything runs, so that the deepest stack excursion can be found later.
+// Runs in .init1, before the stack pointer is set up, hence naked and in asm.
+extern uint8_t _end;
+extern uint8_t __stack;
+extern char *__brkval;
+static const uint8_t STACK_CANARY = 0xc5;
+
+extern "C" void avrPaintStack(void) __attribute__ ((naked, used, section (".init1")));
+void avrPaintStack(void)
+{
+    __asm volatile ("    ldi r30,lo8(_end)\n"
+                    "    ldi r31,hi8(_end)\n"
+                    "    ldi r24,lo8(0xc5)\n" // STACK_CANARY
+                    "    ldi r25,hi8(__stack)\n"
+                    "    rjmp .cmp\n"
+                    ".loop:\n"
+                    "    st Z+,r24\n"
+                    ".cmp:\n"
+                    "    cpi r30,lo8(__stack)\n"
+                    "    cpc r31,r25\n"
+                    "    brlo .loop\n"
+                    "    breq .loop"::);
+}
+
 ISR (TIMER1_COMPA_vect)
 {
     g_millis++;
@@ -141,5 +169,41 @@ public:
                                          IOInterruptFunction func, void *user) {
         MICROFLO_DEBUG(debug, DebugLevelError, DebugIoOperationNotImplemented);
     }
+
+    // Stack
+    // Count untouched canary bytes from the top of the heap upwards towards the stack
+    virtual long StackFreeMinimum(long limit) {
+        const uint8_t *p = __brkval ? (const uint8_t *)__brkval : &_end;
+        long free = 0;
+        while (*p == STACK_CANARY && p <= &__stack) {
+            p++;
+            free++;
+            if (limit > 0 && free >= limit) {
+                break;
+            }
+        }
+        return free;
+    }
+
+    // Storage
+    // All of EEPROM. Erasing a bank only invalidates its header, the rest is overwritten by next graph.
+    // Updating skips bytes that are unchanged, saving wear when same graph is uploaded again
+    virtual long StorageSize() {
+        return E2END+1;
+    }
+    virtual bool StorageErase(long offset, long length) {
+        uint8_t blank[8];
+        memset(blank, 0xFF, sizeof(blank));
+        eeprom_update_block(blank, (void *)(size_t)offset, sizeof(blank));
+        return true;
+    }
+    virtual bool StorageWrite(long offset, const uint8_t *data, uint8_t length) {
+        eeprom_update_block(data, (void *)(size_t)offset, length);
+        return true;
+    }
+    virtual bool StorageRead(long offset, uint8_t *data, uint8_t length) {
+        eeprom_read_block(data, (const void *)(size_t)offset, length);
+        return true;
+    }
 };
 
@@ -0,0 +1,126 @@
+enum GraphCmd {
+    GraphCmdReset = 10,
+    GraphCmdCreateComponent = 11,
+    GraphCmdConnectNodes = 12,
+    GraphCmdSendPacket = 13,
+    GraphCmdEnd = 14,
+    GraphCmdConfigureDebug = 15,
+    GraphCmdSubscribeToPort = 16,
+    GraphCmdConnectSubgraphPort = 17,
+    GraphCmdQueryStackUsage = 18,
+    GraphCmdSendPackets = 19,
+    GraphCmdBeginUpload = 20,
+    GraphCmdConfigureTelemetry = 21,
+    GraphCmdRemoveNode = 22,
+    GraphCmdDisconnectNodes = 23,
+    GraphCmdOpenStream = 24,
+    GraphCmdStreamData = 25,
+    GraphCmdNetworkStopped = 100,
+    GraphCmdNodeAdded = 101,
+    GraphCmdNodesConnected = 102,
+    GraphCmdPacketSent = 103,
+    GraphCmdNetworkStarted = 104,
+    GraphCmdDebugChanged = 105,
+    GraphCmdDebugMessage = 106,
+    GraphCmdPortSubscriptionChanged = 107,
+    GraphCmdSubgraphPortConnected = 108,
+    GraphCmdStackUsage = 109,
+    GraphCmdPacketDelivered = 110,
+    GraphCmdUploadReady = 111,
+    GraphCmdUploadBlockAck = 112,
+    GraphCmdUploadVerified = 113,
+    GraphCmdTelemetryDropped = 114,
+    GraphCmdPortSummary = 115,
+    GraphCmdTelemetryData = 116,
+    GraphCmdTelemetryChannel = 117,
+    GraphCmdTelemetryChanged = 118,
+    GraphCmdNodeRemoved = 119,
+    GraphCmdNodesDisconnected = 120,
+    GraphCmdStreamOpened = 121,
+    GraphCmdStreamCredit = 122,
+    GraphCmdInvalid,
+    GraphCmdMax = 255
+};
+
+enum Msg {
+    MsgInvalid = 0,
+    MsgSetup = 1,
+    MsgTick = 2,
+    MsgVoid = 3,
+    MsgByte = 4,
+    MsgAscii = 5,
+    MsgBoolean = 6,
+    MsgInteger = 7,
+    MsgFloat = 8,
+    MsgBracketStart = 9,
+    MsgBracketEnd = 10,
+    MsgMaxDefined,
+    MsgMax = 255
+};
+
+enum DebugLevel {
+    DebugLevelInvalid = 0,
+    DebugLevelError = 1,
+    DebugLevelInfo = 2,
+    DebugLevelDetailed = 3,
+    DebugLevelVeryDetailed = 4,
+    DebugLevelMax = 255
+};
+
+enum SubscriptionMode {
+    SubscriptionModeAll = 0,
+    SubscriptionModeEveryNth = 1,
+    SubscriptionModeRateLimit = 2,
+    SubscriptionModeSummary = 3
+};
+
+enum TelemetryEncoding {
+    TelemetryEncodingPacket = 0,
+    TelemetryEncodingDelta = 1
+};
+
+enum DebugId {
+    DebugInvalid = 0,
+    DebugProgramStart = 1,
+    DebugComponentCreateStart = 2,
+    DebugComponentCreateEnd = 3,
+    DebugParserInvalidState = 4,
+    DebugParserUnknownState = 5,
+    DebugParseHeader = 6,
+    DebugParseCommand = 7,
+    DebugParseByte = 8,
+    DebugParserUnknownCommand = 9,
+    DebugParserInvalidCommand = 10,
+    DebugParserUnknownPacketType = 11,
+    DebugNetworkConnectInvalidNodes = 12,
+    DebugConnectNodesStart = 13,
+    DebugReadByte = 14,
+    DebugAddNodeInvalidInstance = 15,
+    DebugComponentSendInvalidPort = 16,
+    DebugParseLookForHeader = 17,
+    DebugMagicMismatch = 18,
+    DebugNotImplemented = 19,
+    DebugSubGraphConnectNotASubgraph = 20,
+    DebugSubGraphConnectInvalidNodes = 21,
+    DebugSubGraphReceivedNormalMessage = 22,
+    DebugSendMessageInvalidNode = 23,
+    DebugAddNodeInvalidParent = 24,
+    DebugSubscribePortInvalidNode = 25,
+    DebugIoOperationNotImplemented = 26,
+    DebugInvalidComponentUsed = 27,
+    DebugIoFailure = 28,
+    DebugStackLow = 29,
+    DebugWideMessagePoolFull = 30,
+    DebugFramingError = 31,
+    DebugUploadBlockInvalid = 32,
+    DebugSubscriptionTableFull = 33,
+    DebugRemoveNodeInvalidNode = 34,
+    DebugAddNodeNoFreeId = 35,
+    DebugStorageFull = 36,
+    DebugStorageFailed = 37,
+    DebugGraphImageInvalid = 38,
+    DebugMessagesDropped = 39,
+    DebugStreamInvalid = 40,
+    DebugMessageQueueFull = 41,
+    DebugMax = 255
+};
@@ -0,0 +1,43 @@
+Component *Component::create(ComponentId id) {
+    Component *c;
+    switch (id) {
+    case IdPwmWrite: c = new Components::PwmWrite; c->componentId=id; return c;
+    case IdAnalogRead: c = new Components::AnalogRead; c->componentId=id; return c;
+    case IdForward: c = new Components::Forward; c->componentId=id; return c;
+    case IdCount: c = new Components::Count; c->componentId=id; return c;
+    case IdDigitalWrite: c = new Components::DigitalWrite; c->componentId=id; return c;
+    case IdDigitalRead: c = new Components::DigitalRead; c->componentId=id; return c;
+    case IdTimer: c = new Components::Timer; c->componentId=id; return c;
+    case IdSerialIn: c = new Components::SerialIn; c->componentId=id; return c;
+    case IdSerialOut: c = new Components::SerialOut; c->componentId=id; return c;
+    case IdInvertBoolean: c = new Components::InvertBoolean; c->componentId=id; return c;
+    case IdToggleBoolean: c = new Components::ToggleBoolean; c->componentId=id; return c;
+    case IdHysteresisLatch: c = new Components::HysteresisLatch; c->componentId=id; return c;
+    case IdReadDallasTemperature: c = new Components::ReadDallasTemperature; c->componentId=id; return c;
+    case IdRoute: c = new Components::Route; c->componentId=id; return c;
+    case IdBreakBeforeMake: c = new Components::BreakBeforeMake; c->componentId=id; return c;
+    case IdMapLinear: c = new Components::MapLinear; c->componentId=id; return c;
+    case IdMonitorPin: c = new Components::MonitorPin; c->componentId=id; return c;
+    case IdSplit: c = new Components::Split; c->componentId=id; return c;
+    case IdGate: c = new Components::Gate; c->componentId=id; return c;
+    case IdBooleanOr: c = new Components::BooleanOr; c->componentId=id; return c;
+    case IdBooleanAnd: c = new Components::BooleanAnd; c->componentId=id; return c;
+    case IdReadCapacitivePin: c = new Components::ReadCapacitivePin; c->componentId=id; return c;
+    case IdNumberEquals: c = new Components::NumberEquals; c->componentId=id; return c;
+    case IdMin: c = new Components::Min; c->componentId=id; return c;
+    case IdMax: c = new Components::Max; c->componentId=id; return c;
+    case IdConstrain: c = new Components::Constrain; c->componentId=id; return c;
+    case IdLedMatrixMax: c = new Components::LedMatrixMax; c->componentId=id; return c;
+    case IdLedChainWS: c = new Components::LedChainWS; c->componentId=id; return c;
+    case IdPseudoPwmWrite: c = new Components::PseudoPwmWrite; c->componentId=id; return c;
+    case IdArduinoUno: c = new Components::ArduinoUno; c->componentId=id; return c;
+    case IdATUSBKEY: c = new Components::ATUSBKEY; c->componentId=id; return c;
+    case IdMbedLPC: c = new Components::MbedLPC; c->componentId=id; return c;
+    case IdRaspberryPi: c = new Components::RaspberryPi; c->componentId=id; return c;
+    case IdTivaC: c = new Components::TivaC; c->componentId=id; return c;
+    case IdSPIWrite: c = new Components::SPIWrite; c->componentId=id; return c;
+    case IdRemoteOut: c = new Components::RemoteOut; c->componentId=id; return c;
+    case IdRemoteIn: c = new Components::RemoteIn; c->componentId=id; return c;
+    case IdSubGraph: c = new Components::SubGraph; c->componentId=id; return c;
+    default: return NULL;
+    }}
\ No newline at end of file
@@ -0,0 +1,646 @@
+
+
+namespace PwmWritePorts {
+struct InPorts {
+enum Ports {
+    dutycycle = 0,
+    pin = 1
+};
+};
+struct OutPorts {
+enum Ports {
+    out = 0
+};
+};
+}
+
+namespace AnalogReadPorts {
+struct InPorts {
+enum Ports {
+    trigger = 0,
+    pin = 1
+};
+};
+struct OutPorts {
+enum Ports {
+    out = 0
+};
+};
+}
+
+namespace ForwardPorts {
+struct InPorts {
+enum Ports {
+    in = 0
+};
+};
+struct OutPorts {
+enum Ports {
+    out = 0
+};
+};
+}
+
+namespace CountPorts {
+struct InPorts {
+enum Ports {
+    in = 0,
+    reset = 1
+};
+};
+struct OutPorts {
+enum Ports {
+    out = 0
+};
+};
+}
+
+namespace DigitalWritePorts {
+struct InPorts {
+enum Ports {
+    in = 0,
+    pin = 1
+};
+};
+struct OutPorts {
+enum Ports {
+    out = 0
+};
+};
+}
+
+namespace DigitalReadPorts {
+struct InPorts {
+enum Ports {
+    trigger = 0,
+    pin = 1,
+    pullup = 2
+};
+};
+struct OutPorts {
+enum Ports {
+    out = 0
+};
+};
+}
+
+namespace TimerPorts {
+struct InPorts {
+enum Ports {
+    interval = 0,
+    reset = 2
+};
+};
+struct OutPorts {
+enum Ports {
+    out = 0
+};
+};
+}
+
+namespace SerialInPorts {
+struct InPorts {
+enum Ports {
+    in = 0
+};
+};
+struct OutPorts {
+enum Ports {
+    out = 0
+};
+};
+}
+
+namespace SerialOutPorts {
+struct InPorts {
+enum Ports {
+    in = 0
+};
+};
+struct OutPorts {
+enum Ports {
+    out = 0
+};
+};
+}
+
+namespace InvertBooleanPorts {
+struct InPorts {
+enum Ports {
+    in = 0
+};
+};
+struct OutPorts {
+enum Ports {
+    out = 0
+};
+};
+}
+
+namespace ToggleBooleanPorts {
+struct InPorts {
+enum Ports {
+    in = 0,
+    reset = 1
+};
+};
+struct OutPorts {
+enum Ports {
+    out = 0
+};
+};
+}
+
+namespace HysteresisLatchPorts {
+struct InPorts {
+enum Ports {
+    in = 0,
+    lowthreshold = 1,
+    highthreshold = 2
+};
+};
+struct OutPorts {
+enum Ports {
+    out = 0
+};
+};
+}
+
+namespace ReadDallasTemperaturePorts {
+struct InPorts {
+enum Ports {
+    trigger = 0,
+    pin = 1,
+    address = 2
+};
+};
+struct OutPorts {
+enum Ports {
+    out = 0
+};
+};
+}
+
+namespace RoutePorts {
+struct InPorts {
+enum Ports {
+    port = 0,
+    in1 = 1,
+    in2 = 2,
+    in3 = 3,
+    in4 = 4,
+    in5 = 5,
+    in6 = 6,
+    in7 = 7,
+    in8 = 8,
+    in9 = 9
+};
+};
+struct OutPorts {
+enum Ports {
+    out = 0
+};
+};
+}
+
+namespace BreakBeforeMakePorts {
+struct InPorts {
+enum Ports {
+    in = 0,
+    monitor1 = 1,
+    monitor2 = 2
+};
+};
+struct OutPorts {
+enum Ports {
+    out1 = 0,
+    out2 = 1
+};
+};
+}
+
+namespace MapLinearPorts {
+struct InPorts {
+enum Ports {
+    in = 0,
+    inmin = 1,
+    inmax = 2,
+    outmin = 3,
+    outmax = 4
+};
+};
+struct OutPorts {
+enum Ports {
+    out = 0
+};
+};
+}
+
+namespace MonitorPinPorts {
+struct InPorts {
+enum Ports {
+    pin = 0
+};
+};
+struct OutPorts {
+enum Ports {
+    out = 0
+};
+};
+}
+
+namespace SplitPorts {
+struct InPorts {
+enum Ports {
+    in = 0
+};
+};
+struct OutPorts {
+enum Ports {
+    out1 = 0,
+    out2 = 1,
+    out3 = 2,
+    out4 = 3,
+    out5 = 4,
+    out6 = 5,
+    out7 = 6,
+    out8 = 7,
+    out9 = 8
+};
+};
+}
+
+namespace GatePorts {
+struct InPorts {
+enum Ports {
+    in = 0,
+    enable = 1
+};
+};
+struct OutPorts {
+enum Ports {
+    out = 0
+};
+};
+}
+
+namespace BooleanOrPorts {
+struct InPorts {
+enum Ports {
+    a = 0,
+    b = 1
+};
+};
+struct OutPorts {
+enum Ports {
+    out = 0
+};
+};
+}
+
+namespace BooleanAndPorts {
+struct InPorts {
+enum Ports {
+    a = 0,
+    b = 1
+};
+};
+struct OutPorts {
+enum Ports {
+    out = 0
+};
+};
+}
+
+namespace ReadCapacitivePinPorts {
+struct InPorts {
+enum Ports {
+    trigger = 0,
+    pin = 1,
+    threshold = 2
+};
+};
+struct OutPorts {
+enum Ports {
+    out = 0
+};
+};
+}
+
+namespace NumberEqualsPorts {
+struct InPorts {
+enum Ports {
+    a = 0,
+    b = 1
+};
+};
+struct OutPorts {
+enum Ports {
+    out = 0
+};
+};
+}
+
+namespace MinPorts {
+struct InPorts {
+enum Ports {
+    in = 0,
+    threshold = 1
+};
+};
+struct OutPorts {
+enum Ports {
+    out = 0
+};
+};
+}
+
+namespace MaxPorts {
+struct InPorts {
+enum Ports {
+    in = 0,
+    threshold = 1
+};
+};
+struct OutPorts {
+enum Ports {
+    out = 0
+};
+};
+}
+
+namespace ConstrainPorts {
+struct InPorts {
+enum Ports {
+    in = 0,
+    lower = 1,
+    upper = 2
+};
+};
+struct OutPorts {
+enum Ports {
+    out = 0
+};
+};
+}
+
+namespace LedMatrixMaxPorts {
+struct InPorts {
+enum Ports {
+    in = 0,
+    pincs = 1,
+    pindin = 2,
+    pinclk = 3
+};
+};
+struct OutPorts {
+enum Ports {
+    out = 0
+};
+};
+}
+
+namespace LedChainWSPorts {
+struct InPorts {
+enum Ports {
+    in = 0,
+    pin = 1,
+    pixels = 2,
+    show = 3
+};
+};
+struct OutPorts {
+enum Ports {
+    ready = 0,
+    pixelset = 1
+};
+};
+}
+
+namespace PseudoPwmWritePorts {
+struct InPorts {
+enum Ports {
+    period = 0,
+    ontime = 1,
+    dutycycle = 2,
+    pin = 3
+};
+};
+struct OutPorts {
+enum Ports {
+    out = 0
+};
+};
+}
+
+namespace ArduinoUnoPorts {
+struct InPorts {
+};
+struct OutPorts {
+enum Ports {
+    pin0 = 0,
+    pin1 = 1,
+    pin2 = 2,
+    pin3 = 3,
+    pin4 = 4,
+    pin5 = 5,
+    pin6 = 6,
+    pin7 = 7,
+    pin8 = 8,
+    pin9 = 9,
+    pin10 = 10,
+    pin11 = 11,
+    pin12 = 12,
+    pin13 = 13,
+    pina0 = 14,
+    pina1 = 15,
+    pina2 = 16,
+    pina3 = 17,
+    pina4 = 18,
+    pina5 = 19
+};
+};
+}
+
+namespace ATUSBKEYPorts {
+struct InPorts {
+};
+struct OutPorts {
+enum Ports {
+    porta0 = 0,
+    porta1 = 1,
+    porta2 = 2,
+    porta3 = 3,
+    porta4 = 4,
+    porta5 = 5,
+    porta6 = 6,
+    porta7 = 7,
+    portb0 = 8,
+    portb1 = 9,
+    portb2 = 10,
+    portb3 = 11,
+    portb4 = 12,
+    portb5 = 13,
+    portb6 = 14,
+    portb7 = 15,
+    portc0 = 16,
+    portc1 = 17,
+    portc2 = 18,
+    portc3 = 19,
+    portc4 = 20,
+    portc5 = 21,
+    portc6 = 22,
+    portc7 = 23,
+    portd0 = 24,
+    portd1 = 25,
+    portd2 = 26,
+    portd3 = 27,
+    portd4 = 28,
+    portd5 = 29,
+    portd6 = 30,
+    portd7 = 31,
+    porte0 = 32,
+    porte1 = 33,
+    porte2 = 34,
+    porte3 = 35,
+    porte4 = 36,
+    porte5 = 37,
+    porte6 = 38,
+    porte7 = 39,
+    portf0 = 40,
+    portf1 = 41,
+    portf2 = 42,
+    portf3 = 43,
+    portf4 = 44,
+    portf5 = 45,
+    portf6 = 46,
+    portf7 = 47
+};
+};
+}
+
+namespace MbedLPCPorts {
+struct InPorts {
+};
+struct OutPorts {
+enum Ports {
+    led1 = 0,
+    led2 = 1,
+    led3 = 2,
+    led4 = 3,
+    pin21 = 4,
+    pin22 = 5,
+    pin23 = 6,
+    pin24 = 7
+};
+};
+}
+
+namespace RaspberryPiPorts {
+struct InPorts {
+};
+struct OutPorts {
+enum Ports {
+    pin3 = 1,
+    pin5 = 2,
+    pin7 = 3
+};
+};
+}
+
+namespace TivaCPorts {
+struct InPorts {
+};
+struct OutPorts {
+enum Ports {
+    pa0 = 0,
+    pa1 = 1,
+    pa2 = 2,
+    pa3 = 3,
+    pa4 = 4,
+    pa5 = 5,
+    pa6 = 6,
+    pa7 = 7,
+    pb0 = 8,
+    pb1 = 9,
+    pb2 = 10,
+    pb3 = 11,
+    pb4 = 12,
+    pb5 = 13,
+    pb6 = 14,
+    pb7 = 15,
+    pc0 = 16,
+    pc1 = 17,
+    pc2 = 18,
+    pc3 = 19,
+    pc4 = 20,
+    pc5 = 21,
+    pc6 = 22,
+    pc7 = 23,
+    pd0 = 24,
+    pd1 = 25,
+    pd2 = 26,
+    pd3 = 27,
+    pd4 = 28,
+    pd5 = 29,
+    pd6 = 30,
+    pd7 = 31,
+    pe0 = 32,
+    pe1 = 33,
+    pe2 = 34,
+    pe3 = 35,
+    pe4 = 36,
+    pe5 = 37,
+    pe6 = 38,
+    pe7 = 39,
+    pf0 = 40,
+    pf1 = 41,
+    pf2 = 42,
+    pf3 = 43,
+    pf4 = 44,
+    pf5 = 45,
+    pf6 = 46,
+    pf7 = 47
+};
+};
+}
+
+namespace SPIWritePorts {
+struct InPorts {
+enum Ports {
+    in = 0
+};
+};
+struct OutPorts {
+};
+}
+
+namespace RemoteOutPorts {
+struct InPorts {
+enum Ports {
+    in = 0
+};
+};
+struct OutPorts {
+};
+}
+
+namespace RemoteInPorts {
+struct InPorts {
+enum Ports {
+    in = 0
+};
+};
+struct OutPorts {
+enum Ports {
+    out = 0
+};
+};
+}
+
+namespace SubGraphPorts {
+struct InPorts {
+};
+struct OutPorts {
+};
+}
@@ -0,0 +1,43 @@
+enum ComponentId {
+    IdInvalid = 0,
+    IdPwmWrite = 1,
+    IdAnalogRead = 2,
+    IdForward = 3,
+    IdCount = 4,
+    IdDigitalWrite = 5,
+    IdDigitalRead = 6,
+    IdTimer = 7,
+    IdSerialIn = 8,
+    IdSerialOut = 9,
+    IdInvertBoolean = 10,
+    IdToggleBoolean = 11,
+    IdHysteresisLatch = 12,
+    IdReadDallasTemperature = 13,
+    IdRoute = 14,
+    IdDelimit = 15,
+    IdBreakBeforeMake = 16,
+    IdMapLinear = 17,
+    IdMonitorPin = 18,
+    IdSplit = 19,
+    IdGate = 20,
+    IdBooleanOr = 21,
+    IdBooleanAnd = 22,
+    IdReadCapacitivePin = 23,
+    IdNumberEquals = 24,
+    IdMin = 25,
+    IdMax = 26,
+    IdConstrain = 27,
+    IdLedMatrixMax = 28,
+    IdLedChainWS = 29,
+    IdPseudoPwmWrite = 30,
+    IdArduinoUno = 50,
+    IdATUSBKEY = 51,
+    IdMbedLPC = 52,
+    IdRaspberryPi = 53,
+    IdTivaC = 54,
+    IdSPIWrite = 55,
+    IdRemoteOut = 56,
+    IdRemoteIn = 57,
+    IdSubGraph = 100,
+    Id_Max = 255
+};
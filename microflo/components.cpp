@@ -225,6 +225,10 @@ public:
         using namespace MonitorPinPorts;
         if (port == InPorts::pin) {
             pin = in.asInteger();
+#ifdef LINUX
+            // Any GPIO can interrupt, by its own number
+            const int intr = pin;
+#else
             // FIXME: report error when attempting to use pin without interrupt
             // TODO: support pin mappings for other devices than than Uno/Micro
             int intr = 0;
@@ -233,6 +237,7 @@ public:
             } else if (pin == 3) {
                 intr = 1;
             }
+#endif
             io->PinSetPullup(pin, IO::PullUp);
             io->AttachExternalInterrupt(intr, IO::Interrupt::OnChange, interrupt, this);
             send(Packet(io->DigitalRead(pin)));
@@ -1083,10 +1088,11 @@ private:
         }
     }
 
+    // Data is sampled on rising clock, so clock low and next bit go out together
     void max7219_write_byte(unsigned char DATA) {
+       const MicroFlo::PinId clockAndData[2] = { pin_clk, pin_din };
        for (uint8_t i=8; i>=1; i--) {
-            io->DigitalWrite(pin_clk, false);
-            io->DigitalWrite(pin_din, DATA&0x80);
+            io->DigitalWriteMany(clockAndData, 2, (DATA&0x80) ? 0x2 : 0x0);
             io->DigitalWrite(pin_clk, true);
             DATA = DATA<<1;
        }
@@ -1287,6 +1293,17 @@ private:
     bool currentState;
 };
 
+// Proxies for edges which cross runtimes, inserted when partitioning a graph
+class RemoteOut : public Component {
+public:
+    RemoteOut() : Component(0, 0) {}
+    virtual void process(Packet in, MicroFlo::PortId port) {
+        // Host is subscribed to the edge into this node, and forwards the packets
+    }
+};
+
+class RemoteIn : public Forward {};
+
 
 
 } // namespace Components
@@ -8,30 +8,32 @@
 #include "microflo.h"
 
 #include <string>
+#include <vector>
 #include <algorithm>
 #include <fstream>
+#include <cstdlib>
 #include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <linux/gpio.h>
+
+#include "sharedring.h"
 
 namespace {
     static const std::string SYS_GPIO_BASE = "/sys/class/gpio/";
 
-    static inline std::string &rtrim(std::string &s) {
-            s.erase(std::find_if(s.rbegin(), s.rend(), std::not1(std::ptr_fun<int, int>(std::isspace))).base(), s.end());
-            return s;
-    }
-
-    // PERFORMANCE: string-functions and file open/close for each I/O call. Consider capturing state in a class
-    std::string read_sys_file(const std::string &path) {
-        std::ifstream fs(path.c_str());
-        if (!fs){
-            return "";
-        }
-        std::string res;
-        fs >> res; 
-        fs.close();
-        return res;
-    }
-
+    // Only for configuration. Pin values go through file descriptors kept open by LinuxIO
     bool write_sys_file(const std::string &path, const std::string &value) {
         std::ofstream fs(path.c_str());
         if (!fs){
@@ -55,6 +57,22 @@ namespace {
         }
         return temp;
     }
+
+    bool baud_to_speed(int baudrate, speed_t *speed) {
+        static const struct { int baud; speed_t speed; } speeds[] = {
+            { 1200, B1200 }, { 2400, B2400 }, { 4800, B4800 }, { 9600, B9600 },
+            { 19200, B19200 }, { 38400, B38400 }, { 57600, B57600 }, { 115200, B115200 },
+            { 230400, B230400 }, { 460800, B460800 }, { 500000, B500000 }, { 921600, B921600 },
+            { 1000000, B1000000 }, { 2000000, B2000000 }, { 3000000, B3000000 }, { 4000000, B4000000 }
+        };
+        for (size_t i=0; i<sizeof(speeds)/sizeof(speeds[0]); i++) {
+            if (speeds[i].baud == baudrate) {
+                *speed = speeds[i].speed;
+                return true;
+            }
+        }
+        return false;
+    }
 }
 
 
@@ -64,48 +82,138 @@ namespace {
 class LinuxIO : public IO {
 
 public:
-    LinuxIO() {
+    LinuxIO()
+        : event_time(0)
+        , storage_path(getenv("MICROFLO_STORAGE") ? getenv("MICROFLO_STORAGE") : "microflo-graph.bin")
+        , gpio_base(getenv("MICROFLO_GPIO_BASE") ? getenv("MICROFLO_GPIO_BASE") : SYS_GPIO_BASE)
+    {
         if (clock_gettime(CLOCK_MONOTONIC, &start_time) != 0) {
             MICROFLO_DEBUG(debug, DebugLevelError, DebugIoFailure);
         }
     }
-    ~LinuxIO() {}
+    ~LinuxIO() {
+        for (size_t i=0; i<gpio_value_fds.size(); i++) {
+            if (gpio_value_fds[i] >= 0) {
+                close(gpio_value_fds[i]);
+            }
+        }
+        for (size_t i=0; i<serial_ports.size(); i++) {
+            serial_close(serial_ports[i]);
+        }
+    }
 
     // Serial
-    // TODO: support serial
+    // A tty, /dev/ttySN for @serialDevice N unless MICROFLO_SERIALN environment variable
+    // or SerialSetDevice() names another. Opened non-blocking, and read and written in bulk
+    // through buffers: bytes written are sent from waitForEvents(), or when the buffer is full
     virtual void SerialBegin(int serialDevice, int baudrate) {
-        MICROFLO_DEBUG(debug, DebugLevelError, DebugIoOperationNotImplemented);
+        SerialPort *port = serial_port(serialDevice);
+        speed_t speed;
+        if (!port || !baud_to_speed(baudrate, &speed)) {
+            MICROFLO_DEBUG(debug, DebugLevelError, DebugIoOperationNotImplemented);
+            return;
+        }
+        if (port->fd < 0) {
+            port->fd = open(port->path.c_str(), O_RDWR|O_NOCTTY|O_NONBLOCK|O_CLOEXEC);
+        }
+        termios tty;
+        if (port->fd < 0 || tcgetattr(port->fd, &tty) != 0) {
+            MICROFLO_DEBUG(debug, DebugLevelError, DebugIoFailure);
+            serial_close(*port);
+            return;
+        }
+        cfmakeraw(&tty);
+        tty.c_cflag |= CLOCAL|CREAD;
+        tty.c_cc[VMIN] = 0;
+        tty.c_cc[VTIME] = 0;
+        if (cfsetispeed(&tty, speed) != 0 || cfsetospeed(&tty, speed) != 0
+                || tcsetattr(port->fd, TCSANOW, &tty) != 0) {
+            MICROFLO_DEBUG(debug, DebugLevelError, DebugIoFailure);
+        }
     }
     virtual long SerialDataAvailable(int serialDevice) {
-        MICROFLO_DEBUG(debug, DebugLevelError, DebugIoOperationNotImplemented);
-        return 0;
+        SerialPort *port = serial_port(serialDevice);
+        if (!port || port->fd < 0) {
+            return 0;
+        }
+        if (port->rxRead == port->rxLength) {
+            serial_fill(*port);
+        }
+        return port->rxLength - port->rxRead;
     }
     virtual unsigned char SerialRead(int serialDevice) {
-        MICROFLO_DEBUG(debug, DebugLevelError, DebugIoOperationNotImplemented);
-        return '\0';
+        if (SerialDataAvailable(serialDevice) <= 0) {
+            return '\0';
+        }
+        SerialPort *port = serial_port(serialDevice);
+        return port->rx[port->rxRead++];
     }
     virtual void SerialWrite(int serialDevice, unsigned char b) {
-        MICROFLO_DEBUG(debug, DebugLevelError, DebugIoOperationNotImplemented);
+        SerialPort *port = serial_port(serialDevice);
+        if (!port || port->fd < 0) {
+            MICROFLO_DEBUG(debug, DebugLevelError, DebugIoFailure);
+            return;
+        }
+        if (port->txLength == sizeof(port->tx)) {
+            serial_drain(*port, 0);
+        }
+        if (port->txLength == sizeof(port->tx)) {
+            // Tty is slower than we write. Byte is lost rather than stalling the network,
+            // writers which must not lose data wait with SerialWaitWriteAvailable()
+            MICROFLO_DEBUG(debug, DebugLevelError, DebugIoFailure);
+            return;
+        }
+        port->tx[port->txLength++] = b;
+    }
+    virtual long SerialWriteAvailable(int serialDevice) {
+        SerialPort *port = serial_port(serialDevice);
+        return (port && port->fd >= 0) ? sizeof(port->tx) - port->txLength : 0;
+    }
+    virtual void SerialWaitWriteAvailable(int serialDevice, int timeoutMs) {
+        SerialPort *port = serial_port(serialDevice);
+        if (!port || port->fd < 0 || port->txLength < sizeof(port->tx)) {
+            return;
+        }
+        serial_drain(*port, 0);
+        pollfd p = { port->fd, POLLOUT, 0 };
+        if (port->txLength == sizeof(port->tx) && poll(&p, 1, timeoutMs) > 0) {
+            serial_drain(*port, 0);
+        }
+    }
+
+    // Use tty at @path for @serialDevice. Takes effect on next SerialBegin()
+    void SerialSetDevice(int serialDevice, const std::string &path) {
+        SerialPort *port = serial_port(serialDevice);
+        if (port && port->path != path) {
+            serial_close(*port);
+            port->path = path;
+        }
     }
 
     // Pin config
     virtual void PinSetMode(int pin, IO::PinMode mode) {
-        if (!write_sys_file(SYS_GPIO_BASE+"export", std::to_string(pin))) {
+        if (!write_sys_file(gpio_base+"export", std::to_string(pin))) {
             MICROFLO_DEBUG(debug, DebugLevelError, DebugIoFailure);
             return;
         }
 
         if (mode == IO::InputPin) {
-            if (!write_sys_file(SYS_GPIO_BASE+"gpio"+std::to_string(pin)+"/direction", "in")) {
+            if (!write_sys_file(gpio_base+"gpio"+std::to_string(pin)+"/direction", "in")) {
                 MICROFLO_DEBUG(debug, DebugLevelError, DebugIoFailure);
             }
         } else if (mode == IO::OutputPin) {
-            if (write_sys_file(SYS_GPIO_BASE+"gpio"+std::to_string(pin)+"/direction", "out")) {
+            if (!write_sys_file(gpio_base+"gpio"+std::to_string(pin)+"/direction", "out")) {
                 MICROFLO_DEBUG(debug, DebugLevelError, DebugIoFailure);
             }
         } else {
             MICROFLO_DEBUG(debug, DebugLevelError, DebugIoOperationNotImplemented);
         }
+
+        // Value file may be new after export
+        gpio_close(pin);
+        if (gpio_value_fd(pin) < 0) {
+            MICROFLO_DEBUG(debug, DebugLevelError, DebugIoFailure);
+        }
     }
     virtual void PinSetPullup(int pin, IO::PullupMode mode) {
         // TODO: support pullup/pulldown config on common boards like RPi
@@ -113,6 +221,9 @@ public:
         // http://elinux.org/RPi_Low-level_peripherals#GPIO_Pull_Up.2FPull_Down_Register_Example
         MICROFLO_DEBUG(debug, DebugLevelError, DebugIoOperationNotImplemented);
     }
+    virtual void SPISetMode() {
+        MICROFLO_DEBUG(debug, DebugLevelError, DebugIoOperationNotImplemented);
+    }
 
     // Digital
     virtual void DigitalWrite(int pin, bool val) {
@@ -141,30 +252,942 @@ public:
         return (since_start.tv_sec*1000)+(since_start.tv_nsec/1000000);
     }
 
+    virtual long TimerCurrentMicros() {
+        timespec current_time;
+        if (clock_gettime(CLOCK_MONOTONIC, &current_time) != 0) {
+            MICROFLO_DEBUG(debug, DebugLevelError, DebugIoFailure);
+        }
+        return micros_since_start(current_time);
+    }
+
+    // Interrupts
+    // Edges on GPIO number @interrupt, through the sysfs edge file. Handlers are called
+    // from waitForEvents() in the main loop, not asynchronously, so they can send packets
     virtual void AttachExternalInterrupt(int interrupt, IO::Interrupt::Mode mode,
                                         IOInterruptFunction func, void *user) {
-        MICROFLO_DEBUG(debug, DebugLevelError, DebugIoOperationNotImplemented);
+        const char *edge = (mode == IO::Interrupt::OnChange) ? "both"
+                : (mode == IO::Interrupt::OnRisingEdge) ? "rising"
+                : (mode == IO::Interrupt::OnFallingEdge) ? "falling" : 0;
+        if (!edge) {
+            // Level interrupts are not available from sysfs
+            MICROFLO_DEBUG(debug, DebugLevelError, DebugIoOperationNotImplemented);
+            return;
+        }
+        PinSetMode(interrupt, IO::InputPin);
+        char value;
+        const int fd = gpio_value_fd(interrupt);
+        if (!write_sys_file(gpio_base+"gpio"+std::to_string(interrupt)+"/edge", edge)
+                || fd < 0 || pread(fd, &value, 1, 0) != 1) { // clears pending edge
+            MICROFLO_DEBUG(debug, DebugLevelError, DebugIoFailure);
+            return;
+        }
+        set_edge_handler(interrupt, func, user);
+    }
+    virtual long InterruptTimeMicros() {
+        return event_time;
+    }
+
+    // Sends buffered serial output, then sleeps up to @timeoutMicros, or until a GPIO edge
+    // or serial input. Calls handlers of edges that occurred, returns how many
+    int waitForEvents(long timeoutMicros) {
+        event_fds.clear();
+        const size_t serialFds = add_serial_fds(event_fds);
+        add_event_fds(event_fds);
+        timespec timeout;
+        timeout.tv_sec = timeoutMicros/1000000;
+        timeout.tv_nsec = (timeoutMicros%1000000)*1000;
+        const int ready = ppoll(event_fds.empty() ? 0 : &event_fds[0], event_fds.size(), &timeout, 0);
+        if (ready <= 0) {
+            return 0;
+        }
+        handle_serial_fds(&event_fds[0], serialFds);
+        return handle_events(&event_fds[0]+serialFds, event_fds.size()-serialFds);
+    }
+
+    // Storage
+    // A file, named by MICROFLO_STORAGE environment variable
+    virtual long StorageSize() {
+        return 64*1024;
+    }
+    // Erasing a bank clears its header, the other bank is left as it is
+    virtual bool StorageErase(long offset, long length) {
+        const int fd = open(storage_path.c_str(), O_WRONLY|O_CREAT, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        const uint8_t blank[8] = { 0 };
+        const bool ok = pwrite(fd, blank, sizeof(blank), offset) == sizeof(blank);
+        return (close(fd) == 0) && ok;
+    }
+    virtual bool StorageWrite(long offset, const uint8_t *data, uint8_t length) {
+        const int fd = open(storage_path.c_str(), O_WRONLY);
+        if (fd < 0) {
+            return false;
+        }
+        // Header of a bank is written last. Graph must be on disk before it, and header before we report success
+        const bool header = (offset % (StorageSize()/2) == 0);
+        const bool ok = (!header || fdatasync(fd) == 0)
+                && pwrite(fd, data, length, offset) == length
+                && (!header || fdatasync(fd) == 0);
+        close(fd);
+        return ok;
+    }
+    virtual bool StorageRead(long offset, uint8_t *data, uint8_t length) {
+        const int fd = open(storage_path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        const bool ok = pread(fd, data, length, offset) == length;
+        close(fd);
+        return ok;
+    }
+
+protected:
+    struct EdgeHandler {
+        int pin;
+        IOInterruptFunction func;
+        void *user;
+    };
+
+    void set_edge_handler(int pin, IOInterruptFunction func, void *user) {
+        EdgeHandler h = { pin, func, user };
+        for (size_t i=0; i<edge_handlers.size(); i++) {
+            if (edge_handlers[i].pin == pin) {
+                edge_handlers[i] = h;
+                return;
+            }
+        }
+        edge_handlers.push_back(h);
     }
 
+    // Handler may attach other interrupts, so it is copied out first
+    void call_edge_handler(int pin) {
+        for (size_t i=0; i<edge_handlers.size(); i++) {
+            if (edge_handlers[i].pin == pin) {
+                const EdgeHandler h = edge_handlers[i];
+                h.func(h.user);
+                return;
+            }
+        }
+    }
+
+    long micros_since_start(const timespec &t) {
+        const timespec since_start = timespec_diff(start_time, t);
+        return (since_start.tv_sec*1000000)+(since_start.tv_nsec/1000);
+    }
+
+    // sysfs reports an edge as POLLPRI on the value file. No kernel timestamp, time of wakeup is used
+    virtual void add_event_fds(std::vector<pollfd> &fds) {
+        for (size_t i=0; i<edge_handlers.size(); i++) {
+            pollfd p = { gpio_value_fd(edge_handlers[i].pin), POLLPRI, 0 };
+            fds.push_back(p);
+        }
+    }
+    virtual int handle_events(const pollfd *fds, size_t numFds) {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        event_time = micros_since_start(now);
+        int handled = 0;
+        for (size_t i=0; i<numFds && i<edge_handlers.size(); i++) {
+            char value;
+            if ((fds[i].revents & (POLLPRI|POLLERR)) && pread(fds[i].fd, &value, 1, 0) == 1) {
+                call_edge_handler(edge_handlers[i].pin);
+                handled++;
+            }
+        }
+        return handled;
+    }
+
+    std::vector<EdgeHandler> edge_handlers;
+    long event_time; // of edge being handled, in microseconds like TimerCurrentMicros()
+
 private:
+    // The value file of each pin is opened on first use and kept open,
+    // so a read or write is a single pread()/pwrite()
+    int gpio_value_fd(int number) {
+        if (number < 0) {
+            return -1;
+        }
+        if (number >= (int)gpio_value_fds.size()) {
+            gpio_value_fds.resize(number+1, -1);
+        }
+        int &fd = gpio_value_fds[number];
+        if (fd < 0) {
+            const std::string path = gpio_base + "gpio" + std::to_string(number) + "/value";
+            fd = open(path.c_str(), O_RDWR|O_CLOEXEC);
+            if (fd < 0) {
+                fd = open(path.c_str(), O_RDONLY|O_CLOEXEC);
+            }
+        }
+        return fd;
+    }
+
+    void gpio_close(int number) {
+        if (number >= 0 && number < (int)gpio_value_fds.size() && gpio_value_fds[number] >= 0) {
+            close(gpio_value_fds[number]);
+            gpio_value_fds[number] = -1;
+        }
+    }
+
     // Assumes GPIO is set up as input
     bool gpio_read(int number){
-        std::string path = SYS_GPIO_BASE + "gpio" + std::to_string(number) + "/value";
-        std::string res = read_sys_file(path);
-        if (res.empty()) {
+        const int fd = gpio_value_fd(number);
+        char value = '0';
+        if (fd < 0 || pread(fd, &value, 1, 0) != 1) {
             MICROFLO_DEBUG(debug, DebugLevelError, DebugIoFailure);
         }
-        res = rtrim(res);
-        return res == "1";
+        return value == '1';
     }
 
     // Assumes GPIO is set up as output
     void gpio_write(int number, bool value){
-        std::string path = SYS_GPIO_BASE + "gpio" + std::to_string(number) + "/value";
-        if (!write_sys_file(path, value ? "1" : "0")) {
+        static const char values[2] = { '0', '1' };
+        const int fd = gpio_value_fd(number);
+        if (fd < 0 || pwrite(fd, &values[value ? 1 : 0], 1, 0) != 1) {
             MICROFLO_DEBUG(debug, DebugLevelError, DebugIoFailure);
         }
     }
+
+private:
+    struct SerialPort {
+        int device;
+        std::string path;
+        int fd; // -1 until SerialBegin()
+        uint8_t rx[256];
+        size_t rxRead;
+        size_t rxLength;
+        uint8_t tx[4096];
+        size_t txLength;
+    };
+
+    SerialPort *serial_port(int device) {
+        if (device < 0) {
+            return 0;
+        }
+        for (size_t i=0; i<serial_ports.size(); i++) {
+            if (serial_ports[i].device == device) {
+                return &serial_ports[i];
+            }
+        }
+        const std::string var = "MICROFLO_SERIAL" + std::to_string(device);
+        SerialPort port;
+        port.device = device;
+        port.path = getenv(var.c_str()) ? getenv(var.c_str()) : "/dev/ttyS" + std::to_string(device);
+        port.fd = -1;
+        port.rxRead = port.rxLength = port.txLength = 0;
+        serial_ports.push_back(port);
+        return &serial_ports.back();
+    }
+
+    void serial_close(SerialPort &port) {
+        if (port.fd >= 0) {
+            serial_drain(port, 100);
+            close(port.fd);
+            port.fd = -1;
+        }
+        port.rxRead = port.rxLength = port.txLength = 0;
+    }
+
+    // Only when everything read before has been consumed
+    void serial_fill(SerialPort &port) {
+        ssize_t n;
+        do {
+            n = read(port.fd, port.rx, sizeof(port.rx));
+        } while (n < 0 && errno == EINTR);
+        port.rxRead = 0;
+        port.rxLength = (n > 0) ? n : 0;
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            MICROFLO_DEBUG(debug, DebugLevelError, DebugIoFailure);
+        }
+    }
+
+    // Writes out as much as the tty takes, waiting up to @timeoutMs each time it takes nothing
+    void serial_drain(SerialPort &port, int timeoutMs) {
+        while (port.txLength > 0) {
+            const ssize_t n = write(port.fd, port.tx, port.txLength);
+            if (n > 0) {
+                memmove(port.tx, port.tx+n, port.txLength-n);
+                port.txLength -= n;
+                continue;
+            }
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                MICROFLO_DEBUG(debug, DebugLevelError, DebugIoFailure);
+                return;
+            }
+            pollfd p = { port.fd, POLLOUT, 0 };
+            if (timeoutMs <= 0 || poll(&p, 1, timeoutMs) <= 0) {
+                return;
+            }
+        }
+    }
+
+    // Wakes up for input when the receive buffer is empty, and for output while some is pending.
+    // Returns number of fds added
+    size_t add_serial_fds(std::vector<pollfd> &fds) {
+        size_t added = 0;
+        for (size_t i=0; i<serial_ports.size(); i++) {
+            SerialPort &port = serial_ports[i];
+            if (port.fd < 0) {
+                continue;
+            }
+            serial_drain(port, 0);
+            const short events = ((port.rxRead == port.rxLength) ? POLLIN : 0) | (port.txLength ? POLLOUT : 0);
+            if (events) {
+                pollfd p = { port.fd, events, 0 };
+                fds.push_back(p);
+                added++;
+            }
+        }
+        return added;
+    }
+    void handle_serial_fds(const pollfd *fds, size_t count) {
+        for (size_t i=0; i<count; i++) {
+            for (size_t j=0; j<serial_ports.size(); j++) {
+                SerialPort &port = serial_ports[j];
+                if (port.fd != fds[i].fd) {
+                    continue;
+                }
+                if ((fds[i].revents & POLLIN) && port.rxRead == port.rxLength) {
+                    serial_fill(port);
+                }
+                if (fds[i].revents & POLLOUT) {
+                    serial_drain(port, 0);
+                }
+            }
+        }
+    }
+
 private:
     struct timespec start_time;
+    std::string storage_path;
+    std::string gpio_base;
+    std::vector<int> gpio_value_fds; // by pin number, -1 if not open
+    std::vector<SerialPort> serial_ports;
+    std::vector<pollfd> event_fds;
+};
+
+#ifdef GPIO_V2_GET_LINE_IOCTL
+/**
+ * GPIO through the character device (/dev/gpiochipN, kernel 5.10+) instead of sysfs.
+ * Pin numbers, and interrupt numbers, are line offsets on the chip. All configured lines are held in one
+ * line request, so DigitalWriteMany()/DigitalReadMany() change or sample them in
+ * a single ioctl. Changing mode, pullup or edges of a requested line reconfigures the request in place.
+ * Adding a line requests all of them again, losing pending edge events, so configure pins first.
+*/
+class LinuxGpioChipIO : public LinuxIO {
+public:
+    LinuxGpioChipIO(const std::string &chip)
+        : chip_path(chip)
+        , chip_fd(-1)
+        , request_fd(-1)
+        , num_lines(0)
+        , requested_lines(0)
+        , outputs(0)
+        , pullups(0)
+        , rising(0)
+        , falling(0)
+        , levels(0)
+    {}
+    ~LinuxGpioChipIO() {
+        if (request_fd >= 0) {
+            close(request_fd);
+        }
+        if (chip_fd >= 0) {
+            close(chip_fd);
+        }
+    }
+
+    // Pin config
+    virtual void PinSetMode(int pin, IO::PinMode mode) {
+        const int line = line_index(pin, true);
+        if (line < 0) {
+            MICROFLO_DEBUG(debug, DebugLevelError, DebugIoFailure);
+            return;
+        }
+        if (mode == IO::OutputPin) {
+            outputs |= 1ULL << line;
+            rising &= ~(1ULL << line);
+            falling &= ~(1ULL << line);
+        } else if (mode == IO::InputPin) {
+            outputs &= ~(1ULL << line);
+        } else {
+            MICROFLO_DEBUG(debug, DebugLevelError, DebugIoOperationNotImplemented);
+        }
+        if (!request_lines()) {
+            MICROFLO_DEBUG(debug, DebugLevelError, DebugIoFailure);
+        }
+    }
+    virtual void PinSetPullup(int pin, IO::PullupMode mode) {
+        const int line = line_index(pin, true);
+        if (line < 0) {
+            MICROFLO_DEBUG(debug, DebugLevelError, DebugIoFailure);
+            return;
+        }
+        if (mode == IO::PullUp) {
+            pullups |= 1ULL << line;
+        } else {
+            pullups &= ~(1ULL << line);
+        }
+        if (!request_lines()) {
+            MICROFLO_DEBUG(debug, DebugLevelError, DebugIoFailure);
+        }
+    }
+
+    // Interrupts
+    // Edge detection is enabled on the line, events carry the kernel timestamp
+    virtual void AttachExternalInterrupt(int interrupt, IO::Interrupt::Mode mode,
+                                         IOInterruptFunction func, void *user) {
+        const bool onRising = (mode == IO::Interrupt::OnChange || mode == IO::Interrupt::OnRisingEdge);
+        const bool onFalling = (mode == IO::Interrupt::OnChange || mode == IO::Interrupt::OnFallingEdge);
+        if (!onRising && !onFalling) {
+            MICROFLO_DEBUG(debug, DebugLevelError, DebugIoOperationNotImplemented);
+            return;
+        }
+        const int line = line_index(interrupt, true);
+        if (line < 0) {
+            MICROFLO_DEBUG(debug, DebugLevelError, DebugIoFailure);
+            return;
+        }
+        const uint64_t bit = 1ULL << line;
+        outputs &= ~bit;
+        rising = onRising ? (rising | bit) : (rising & ~bit);
+        falling = onFalling ? (falling | bit) : (falling & ~bit);
+        set_edge_handler(interrupt, func, user);
+        if (!request_lines()) {
+            MICROFLO_DEBUG(debug, DebugLevelError, DebugIoFailure);
+        }
+    }
+
+    // Digital
+    virtual void DigitalWrite(int pin, bool val) {
+        const MicroFlo::PinId p = pin;
+        DigitalWriteMany(&p, 1, val ? 1 : 0);
+    }
+    virtual bool DigitalRead(int pin) {
+        const MicroFlo::PinId p = pin;
+        return DigitalReadMany(&p, 1) & 1;
+    }
+    virtual void DigitalWriteMany(const MicroFlo::PinId *pins, uint8_t count, uint32_t values) {
+        gpio_v2_line_values v;
+        if (!line_mask(pins, count, &v.mask)) {
+            MICROFLO_DEBUG(debug, DebugLevelError, DebugIoFailure);
+            return;
+        }
+        v.bits = 0;
+        for (uint8_t i=0; i<count; i++) {
+            if ((values >> i) & 1) {
+                v.bits |= 1ULL << line_index(pins[i], false);
+            }
+        }
+        if (gpio_ioctl(request_fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &v) != 0) {
+            MICROFLO_DEBUG(debug, DebugLevelError, DebugIoFailure);
+            return;
+        }
+        levels = (levels & ~v.mask) | v.bits;
+    }
+    virtual uint32_t DigitalReadMany(const MicroFlo::PinId *pins, uint8_t count) {
+        gpio_v2_line_values v;
+        v.bits = 0;
+        if (!line_mask(pins, count, &v.mask)
+                || gpio_ioctl(request_fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &v) != 0) {
+            MICROFLO_DEBUG(debug, DebugLevelError, DebugIoFailure);
+            return 0;
+        }
+        uint32_t values = 0;
+        for (uint8_t i=0; i<count; i++) {
+            values |= (uint32_t)((v.bits >> line_index(pins[i], false)) & 1) << i;
+        }
+        return values;
+    }
+
+protected:
+    // Overridden to run against a mocked chip
+    virtual int gpio_ioctl(int fd, unsigned long request, void *arg) {
+        return ioctl(fd, request, arg);
+    }
+
+    // Edges of all lines are read from the line request
+    virtual void add_event_fds(std::vector<pollfd> &fds) {
+        if (request_fd >= 0 && (rising|falling)) {
+            pollfd p = { request_fd, POLLIN, 0 };
+            fds.push_back(p);
+        }
+    }
+    virtual int handle_events(const pollfd *fds, size_t numFds) {
+        if (numFds == 0 || !(fds[0].revents & POLLIN)) {
+            return 0;
+        }
+        gpio_v2_line_event events[16];
+        const ssize_t n = read(request_fd, events, sizeof(events));
+        if (n < (ssize_t)sizeof(events[0])) {
+            MICROFLO_DEBUG(debug, DebugLevelError, DebugIoFailure);
+            return 0;
+        }
+        const int count = n/sizeof(events[0]);
+        for (int i=0; i<count; i++) {
+            timespec t;
+            t.tv_sec = events[i].timestamp_ns/1000000000;
+            t.tv_nsec = events[i].timestamp_ns%1000000000;
+            event_time = micros_since_start(t);
+            call_edge_handler(events[i].offset);
+        }
+        return count;
+    }
+
+private:
+    // Index of @pin in the line request, -1 if not requested (and not @add, or full)
+    int line_index(MicroFlo::PinId pin, bool add) {
+        for (int i=0; i<num_lines; i++) {
+            if (offsets[i] == (uint32_t)pin) {
+                return i;
+            }
+        }
+        if (!add || pin < 0 || num_lines == GPIO_V2_LINES_MAX) {
+            return -1;
+        }
+        offsets[num_lines] = pin;
+        return num_lines++;
+    }
+
+    bool line_mask(const MicroFlo::PinId *pins, uint8_t count, __u64 *mask) {
+        *mask = 0;
+        for (uint8_t i=0; i<count; i++) {
+            const int line = line_index(pins[i], false);
+            if (line < 0) {
+                return false;
+            }
+            *mask |= 1ULL << line;
+        }
+        return request_fd >= 0;
+    }
+
+    uint64_t line_flags(int line) {
+        const uint64_t bit = 1ULL << line;
+        if (outputs & bit) {
+            return GPIO_V2_LINE_FLAG_OUTPUT;
+        }
+        return GPIO_V2_LINE_FLAG_INPUT
+                | ((pullups & bit) ? GPIO_V2_LINE_FLAG_BIAS_PULL_UP : 0)
+                | ((rising & bit) ? GPIO_V2_LINE_FLAG_EDGE_RISING : 0)
+                | ((falling & bit) ? GPIO_V2_LINE_FLAG_EDGE_FALLING : 0);
+    }
+
+    // Inputs by default, outputs keep their last level.
+    // Lines with the same flags share a config attribute
+    // Existing request is reconfigured, unless lines were added
+    bool request_lines() {
+        if (chip_fd < 0) {
+            chip_fd = open(chip_path.c_str(), O_RDWR|O_CLOEXEC);
+            if (chip_fd < 0) {
+                return false;
+            }
+        }
+
+        gpio_v2_line_request request;
+        memset(&request, 0, sizeof(request));
+        memcpy(request.offsets, offsets, num_lines*sizeof(offsets[0]));
+        strncpy(request.consumer, "microflo", sizeof(request.consumer)-1);
+        request.num_lines = num_lines;
+        request.config.flags = GPIO_V2_LINE_FLAG_INPUT;
+        gpio_v2_line_config_attribute *attrs = request.config.attrs;
+        int numAttrs = 0;
+        if (outputs) {
+            attrs[numAttrs].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+            attrs[numAttrs].attr.values = levels;
+            attrs[numAttrs++].mask = outputs;
+        }
+        for (int line=0; line<num_lines; line++) {
+            const uint64_t flags = line_flags(line);
+            if (flags == request.config.flags) {
+                continue;
+            }
+            int a = 0;
+            while (a < numAttrs && !(attrs[a].attr.id == GPIO_V2_LINE_ATTR_ID_FLAGS && attrs[a].attr.flags == flags)) {
+                a++;
+            }
+            if (a == GPIO_V2_LINE_NUM_ATTRS_MAX) {
+                return false;
+            } else if (a == numAttrs) {
+                attrs[a].attr.id = GPIO_V2_LINE_ATTR_ID_FLAGS;
+                attrs[a].attr.flags = flags;
+                numAttrs++;
+            }
+            attrs[a].mask |= 1ULL << line;
+        }
+        request.config.num_attrs = numAttrs;
+
+        if (request_fd >= 0 && requested_lines == num_lines) {
+            return gpio_ioctl(request_fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &request.config) == 0;
+        }
+
+        // Lines of the old request are busy until it is released
+        if (request_fd >= 0) {
+            close(request_fd);
+            request_fd = -1;
+        }
+        if (gpio_ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &request) != 0 || request.fd <= 0) {
+            return false;
+        }
+        request_fd = request.fd;
+        requested_lines = num_lines;
+        return true;
+    }
+
+private:
+    std::string chip_path;
+    int chip_fd;
+    int request_fd; // -1 until lines are requested
+    uint32_t offsets[GPIO_V2_LINES_MAX];
+    int num_lines;
+    int requested_lines; // lines in request_fd
+    uint64_t outputs; // bit per line in request
+    uint64_t pullups;
+    uint64_t rising;
+    uint64_t falling;
+    uint64_t levels; // last written output values
+};
+#endif // GPIO_V2_GET_LINE_IOCTL
+
+// Build network from a precompiled graph image file (.fbgi), mapped instead of read.
+// Returns false if file cannot be mapped or is not a valid image
+inline bool loadGraphImageFile(HostCommunication *controller, const char *path) {
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    void *image = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        image = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (image == MAP_FAILED) {
+        return false;
+    }
+    const bool ok = controller->loadGraphImage((const uint8_t *)image, st.st_size);
+    munmap(image, st.st_size);
+    return ok;
+}
+
+
+/**
+ * Host transport over TCP or Unix domain socket, so a Linux runtime can be monitored and reprogrammed.
+ * Address is "tcp:PORT", "tcp:HOST:PORT" or "unix:PATH". There is no authentication, so "tcp:PORT"
+ * only listens on 127.0.0.1. Other machines can connect only if HOST names an interface, like 0.0.0.0.
+ * Several clients can be connected, and all receive every command.
+ * Input from clients is parsed as one stream, so only one of them should send at a time.
+*/
+class SocketHostTransport : public HostTransport {
+public:
+    SocketHostTransport(const std::string &addr)
+        : address(addr)
+        , listener(-1)
+        , dropped(0)
+        , io(0)
+        , controller(0)
+    {}
+    ~SocketHostTransport() {
+        for (size_t i=0; i<clients.size(); i++) {
+            close(clients[i].fd);
+        }
+        if (listener >= 0) {
+            close(listener);
+            if (isUnix()) {
+                unlink(address.substr(5).c_str());
+            }
+        }
+    }
+
+    // implements HostTransport
+    virtual void setup(IO *i, HostCommunication *c) {
+        io = i;
+        controller = c;
+        listener = openListener();
+        if (listener < 0) {
+            MICROFLO_DEBUG(controller, DebugLevelError, DebugIoFailure);
+        }
+    }
+
+    virtual void runTick() {
+        controller->flushTelemetry();
+        acceptClients();
+        readClients();
+        controller->flushDebug();
+        writeClients();
+
+        bool flushed = true;
+        for (size_t i=0; i<clients.size(); i++) {
+            flushed = flushed && clients[i].out.empty();
+        }
+        if (dropped > 0 && flushed) {
+            const uint16_t n = dropped;
+            dropped = 0;
+            controller->telemetryDropped(n);
+        }
+    }
+
+    virtual bool beginCommand(int bytes, bool droppable) {
+        if (!droppable || canSend(bytes)) {
+            return true;
+        }
+        if (dropped < 0xFFFF) {
+            dropped++;
+        }
+        return false;
+    }
+
+    virtual bool canSend(int bytes) {
+        for (size_t i=0; i<clients.size(); i++) {
+            if (clients[i].out.size()+bytes > bufferLimit) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    virtual void sendCommandByte(uint8_t b) {
+        // Written by writeClients() at end of tick, or next tick
+        for (size_t i=0; i<clients.size(); i++) {
+            clients[i].out.push_back(b);
+        }
+    }
+
+private:
+    struct Client {
+        int fd;
+        std::string out;
+    };
+    static const size_t maxClients = 4;
+    // Telemetry is dropped above this, and a client which does not read is closed at 4 times this
+    static const size_t bufferLimit = 16*1024;
+
+    bool isUnix() const { return address.compare(0, 5, "unix:") == 0; }
+
+    int openListener() {
+        sockaddr_un unixAddr;
+        sockaddr_in tcpAddr;
+        sockaddr *addr = 0;
+        socklen_t length = 0;
+        if (isUnix()) {
+            const std::string path = address.substr(5);
+            if (path.size() >= sizeof(unixAddr.sun_path)) {
+                return -1;
+            }
+            memset(&unixAddr, 0, sizeof(unixAddr));
+            unixAddr.sun_family = AF_UNIX;
+            strcpy(unixAddr.sun_path, path.c_str());
+            unlink(path.c_str());
+            addr = (sockaddr *)&unixAddr;
+            length = sizeof(unixAddr);
+        } else if (address.compare(0, 4, "tcp:") == 0) {
+            memset(&tcpAddr, 0, sizeof(tcpAddr));
+            tcpAddr.sin_family = AF_INET;
+            tcpAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            const size_t colon = address.find(':', 4);
+            if (colon != std::string::npos
+                    && inet_pton(AF_INET, address.substr(4, colon-4).c_str(), &tcpAddr.sin_addr) != 1) {
+                return -1;
+            }
+            const std::string port = (colon != std::string::npos) ? address.substr(colon+1) : address.substr(4);
+            tcpAddr.sin_port = htons(atoi(port.c_str()));
+            addr = (sockaddr *)&tcpAddr;
+            length = sizeof(tcpAddr);
+        } else {
+            return -1;
+        }
+
+        const int reuse = 1;
+        const int fd = socket(addr->sa_family, SOCK_STREAM, 0);
+        if (fd >= 0
+            && (isUnix() || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) == 0)
+            && bind(fd, addr, length) == 0
+            && listen(fd, maxClients) == 0
+            && fcntl(fd, F_SETFL, O_NONBLOCK) == 0) {
+            return fd;
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+
+    void acceptClients() {
+        if (listener < 0) {
+            return;
+        }
+        int fd;
+        while ((fd = accept(listener, 0, 0)) >= 0) {
+            if (clients.size() >= maxClients || fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+                close(fd);
+                continue;
+            }
+            if (!isUnix()) {
+                // Commands are small and latency matters more than packet count
+                const int nodelay = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+            }
+            Client c;
+            c.fd = fd;
+            clients.push_back(c);
+        }
+    }
+
+    void readClients() {
+        uint8_t chunk[256];
+        for (size_t i=0; i<clients.size(); i++) {
+            ssize_t n;
+            while ((n = recv(clients[i].fd, chunk, sizeof(chunk), 0)) > 0) {
+                controller->parseBytes(chunk, n);
+            }
+            if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                closeClient(i--);
+            }
+        }
+    }
+
+    void writeClients() {
+        for (size_t i=0; i<clients.size(); i++) {
+            Client &c = clients[i];
+            while (!c.out.empty()) {
+                const ssize_t n = send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+                if (n > 0) {
+                    c.out.erase(0, n);
+                } else {
+                    break;
+                }
+            }
+            const bool failed = !c.out.empty() && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR;
+            if (failed || c.out.size() > 4*bufferLimit) {
+                closeClient(i--);
+            }
+        }
+    }
+
+    void closeClient(size_t index) {
+        close(clients[index].fd);
+        clients.erase(clients.begin()+index);
+    }
+
+private:
+    std::string address;
+    int listener;
+    std::vector<Client> clients;
+    uint16_t dropped;
+    IO *io;
+    HostCommunication *controller;
+};
+
+/**
+ * Host transport for a supervisor process on the same board, through rings in shared memory.
+ * Address is "shm:/NAME". Input is parsed in place from the ring, and output written directly
+ * into it, so there are no copies or syscalls per command. When host lags and the ring is full,
+ * commands are dropped whole, never waited for. See sharedring.h for the host side.
+*/
+class SharedMemoryHostTransport : public HostTransport {
+public:
+    SharedMemoryHostTransport(const std::string &addr)
+        : name(addr.substr(4))
+        , rings(0)
+        , pendingHead(0)
+        , dropped(0)
+        , written(false)
+        , controller(0)
+    {}
+    ~SharedMemoryHostTransport() {
+        if (rings) {
+            sharedRingsClose(rings);
+            shm_unlink(name.c_str());
+        }
+    }
+
+    // implements HostTransport
+    virtual void setup(IO *i, HostCommunication *c) {
+        controller = c;
+        rings = sharedRingsOpen(name.c_str(), true);
+        if (!rings) {
+            MICROFLO_DEBUG(controller, DebugLevelError, DebugIoFailure);
+        }
+    }
+
+    virtual void runTick() {
+        if (!rings) {
+            return;
+        }
+        controller->flushTelemetry();
+
+        const uint8_t *data;
+        uint32_t length;
+        while ((length = sharedRingPeek(&rings->toRuntime, &data)) > 0) {
+            controller->parseBytes(data, length);
+            sharedRingConsume(&rings->toRuntime, length);
+        }
+        controller->flushDebug();
+
+        if (dropped > 0 && space() == MICROFLO_SHARED_RING_SIZE) {
+            const uint16_t n = dropped;
+            dropped = 0;
+            controller->telemetryDropped(n);
+        }
+        publish();
+        if (written) {
+            written = false;
+            sharedRingNotify(&rings->toHost);
+        }
+    }
+
+    virtual bool beginCommand(int bytes, bool droppable) {
+        if (!rings) {
+            return true;
+        }
+        if (canSend(bytes)) {
+            return true;
+        }
+        // Even commands host depends on are dropped whole rather than waited for, so a slow
+        // host does not stall the network, and frames stay aligned. Host is told how many
+        // with TelemetryDropped once it has caught up
+        if (dropped < 0xFFFF) {
+            dropped++;
+        }
+        sharedRingNotify(&rings->toHost);
+        return false;
+    }
+
+    virtual bool canSend(int bytes) {
+        if (!rings) {
+            return true;
+        }
+        publish();
+        return space() >= (uint32_t)bytes;
+    }
+
+    virtual void sendCommandByte(uint8_t b) {
+        // Made visible to host by publish(), once per command instead of per byte.
+        // Room was checked by beginCommand()
+        if (rings && space() > 0) {
+            rings->toHost.data[pendingHead % MICROFLO_SHARED_RING_SIZE] = b;
+            pendingHead++;
+        }
+    }
+
+private:
+    uint32_t space() const {
+        return MICROFLO_SHARED_RING_SIZE - (pendingHead - __atomic_load_n(&rings->toHost.tail, __ATOMIC_ACQUIRE));
+    }
+    void publish() {
+        if (pendingHead != rings->toHost.head) {
+            __atomic_store_n(&rings->toHost.head, pendingHead, __ATOMIC_SEQ_CST);
+            written = true;
+        }
+    }
+
+private:
+    std::string name;
+    SharedRings *rings;
+    uint32_t pendingHead;
+    uint16_t dropped;
+    bool written;
+    HostCommunication *controller;
 };
@@ -15,22 +15,122 @@
 #include <unistd.h>
 #endif
 
+// Graph compiled into the firmware, see MICROFLO_EMBED_GRAPH
+#ifdef MICROFLO_EMBED_GRAPH_COMPRESSED
+// Compressed image, see compressCmdStream() in commandstream.js.
+// Commands are expanded one at a time, so no RAM is needed for the graph
 #ifdef AVR
 #include <avr/pgmspace.h>
+static uint8_t graphByte(unsigned int pos) {
+    return pgm_read_byte(graph+pos);
+}
+#else
+static uint8_t graphByte(unsigned int pos) {
+    return graph[pos];
+}
+#endif
 
-void loadFromEEPROM(HostCommunication *controller) {
-    for (unsigned int i=0; i<sizeof(graph); i++) {
-        unsigned char c = pgm_read_byte_near(graph+i);
-        controller->parseByte(c);
+static uint32_t graphVarint(unsigned int *pos) {
+    uint32_t value = 0;
+    uint8_t shift = 0;
+    uint8_t b;
+    do {
+        b = graphByte((*pos)++);
+        value |= (uint32_t)(b & 0x7F) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    return value;
+}
+
+// Decode one payload of @type at @pos into @out, returns its size
+static uint8_t graphPayload(unsigned int *pos, uint8_t type, uint8_t *out) {
+    if (type == MsgInteger) {
+        const uint32_t zigzag = graphVarint(pos);
+        const uint32_t value = (zigzag >> 1) ^ (0-(zigzag & 1));
+        for (uint8_t i=0; i<4; i++) {
+            out[i] = (value >> (8*i)) & 0xFF;
+        }
+        return 4;
+    } else if (type == MsgByte || type == MsgBoolean) {
+        out[0] = graphByte((*pos)++);
+        return 1;
+    } else if (type == MsgVoid || type == MsgBracketStart || type == MsgBracketEnd) {
+        return 0;
+    }
+    for (uint8_t i=0; i<4; i++) {
+        out[i] = graphByte((*pos)++);
     }
+    return 4;
 }
-#else
-void loadFromEEPROM(HostCommunication *controller) {
-        for (unsigned int i=0; i<sizeof(graph); i++) {
-        unsigned char c = graph[i];
-        controller->parseByte(c);
+
+// Where to read payloads of @type: at @pos, or if it refers back to earlier ones, at @ref
+static unsigned int *graphPayloadAt(unsigned int *pos, uint8_t *type, unsigned int *ref) {
+    if (!(*type & 0x80)) {
+        return pos;
+    }
+    *type &= 0x7F;
+    const unsigned int start = *pos;
+    *ref = start - graphVarint(pos);
+    return ref;
+}
+
+void loadEmbeddedGraph(HostCommunication *controller) {
+    const uint8_t magic[] = { 'u','C','/','F','l','o','0','1' };
+    controller->parseBytes(magic, sizeof(magic));
+
+    unsigned int pos = 0;
+    while (pos < sizeof(graph)) {
+        uint8_t cmd[MICROFLO_CMD_SIZE];
+        memset(cmd, 0, sizeof(cmd));
+        const uint8_t header = graphByte(pos++);
+        const uint8_t length = header >> 5;
+        cmd[0] = header & 0x1F;
+        if (cmd[0] == GraphCmdSendPacket) {
+            cmd[1] = graphByte(pos++);
+            cmd[2] = graphByte(pos++);
+            uint8_t type = graphByte(pos++);
+            unsigned int ref;
+            unsigned int *payload = graphPayloadAt(&pos, &type, &ref);
+            cmd[3] = type;
+            graphPayload(payload, type, cmd+4);
+        } else {
+            for (uint8_t i=0; i<length; i++) {
+                cmd[1+i] = graphByte(pos++);
+            }
+        }
+        controller->parseBytes(cmd, sizeof(cmd));
+
+        for (uint8_t run=0; cmd[0] == GraphCmdSendPackets && run<cmd[1]; run++) {
+            uint8_t runHeader[4];
+            for (uint8_t i=0; i<4; i++) {
+                runHeader[i] = graphByte(pos++);
+            }
+            unsigned int ref;
+            unsigned int *payload = graphPayloadAt(&pos, &runHeader[2], &ref);
+            controller->parseBytes(runHeader, sizeof(runHeader));
+            for (uint8_t i=0; i<runHeader[3]; i++) {
+                uint8_t value[4];
+                const uint8_t size = graphPayload(payload, runHeader[2], value);
+                controller->parseBytes(value, size);
+            }
+        }
+    }
+}
+#elif defined(AVR)
+#include <avr/pgmspace.h>
+
+void loadEmbeddedGraph(HostCommunication *controller) {
+    uint8_t chunk[MICROFLO_CMD_SIZE*2];
+    for (unsigned int i=0; i<sizeof(graph); i+=sizeof(chunk)) {
+        const unsigned int n = (sizeof(graph)-i < sizeof(chunk)) ? sizeof(graph)-i : sizeof(chunk);
+        memcpy_P(chunk, graph+i, n);
+        controller->parseBytes(chunk, n);
     }
 }
+#else
+void loadEmbeddedGraph(HostCommunication *controller) {
+    controller->parseBytes(graph, sizeof(graph));
+}
 #endif
 
 // I/O backend to use
@@ -49,8 +149,16 @@ MbedIO io;
 #endif
 
 #ifdef LINUX
+#ifdef GPIO_V2_GET_LINE_IOCTL
+// GPIO through sysfs, or the character device named by MICROFLO_GPIOCHIP (like /dev/gpiochip0)
+const char *gpioChip = getenv("MICROFLO_GPIOCHIP");
+LinuxIO sysfsIO;
+LinuxGpioChipIO gpioChipIO(gpioChip ? gpioChip : "");
+LinuxIO &io = gpioChip ? (LinuxIO &)gpioChipIO : sysfsIO;
+#else
 LinuxIO io;
 #endif
+#endif
 
 #ifdef STELLARIS
 #include "stellaris.hpp"
@@ -63,20 +171,58 @@ Network network(&io);
 HostCommunication controller;
 
 #ifdef LINUX
-// TODO: add IP-based host transport
-NullHostTransport transport;
+// "tcp:PORT" (localhost only), "tcp:HOST:PORT", "unix:PATH", "shm:/NAME" or "serial:/dev/TTY",
+// can be overridden with MICROFLO_HOST environment variable
+#ifndef MICROFLO_HOST_ADDRESS
+#define MICROFLO_HOST_ADDRESS "tcp:3570"
+#endif
+const std::string hostAddress = getenv("MICROFLO_HOST") ? getenv("MICROFLO_HOST") : MICROFLO_HOST_ADDRESS;
+const bool hostSerial = (hostAddress.compare(0, 7, "serial:") == 0);
+
+// Only the transport in use is constructed
+HostTransport &hostTransport() {
+    if (hostSerial) {
+        static SerialHostTransport serialTransport(serialPort, serialBaudrate);
+        return serialTransport;
+    } else if (hostAddress.compare(0, 4, "shm:") == 0) {
+        static SharedMemoryHostTransport sharedMemoryTransport(hostAddress);
+        return sharedMemoryTransport;
+    }
+    static SocketHostTransport socketTransport(hostAddress);
+    return socketTransport;
+}
+HostTransport &transport = hostTransport();
 #else
 SerialHostTransport transport(serialPort, serialBaudrate);
 #endif
 
 void setup()
 {
+#ifdef LINUX
+    if (hostSerial) {
+        io.SerialSetDevice(serialPort, hostAddress.substr(7));
+    }
+#endif
     transport.setup(&io, &controller);
     network.emitDebug(DebugLevelInfo, DebugProgramStart);
     controller.setup(&network, &transport);
 
+#ifdef LINUX
+    // Precompiled graph image given on start takes precedence over stored and embedded graph
+    const char *image = getenv("MICROFLO_GRAPH");
+    if (image && loadGraphImageFile(&controller, image)) {
+        return;
+    }
+#endif
+#ifdef MICROFLO_PERSIST_GRAPH
+    // Last uploaded graph takes precedence over the embedded one
+    controller.setStorage(&io);
+    if (controller.loadStoredGraph()) {
+        return;
+    }
+#endif
 #ifdef MICROFLO_EMBED_GRAPH
-    loadFromEEPROM(&controller);
+    loadEmbeddedGraph(&controller);
 #endif
 }
 
@@ -133,8 +279,9 @@ int main(void) {
     while(1) {
         loop();
 #ifdef LINUX
-        // HACK: do some sane scheduling instead
-        usleep(1);
+        // As short as usleep(1) was, but a GPIO edge ends it and its handler runs right away.
+        // Also sends what was written to serial during the tick
+        io.waitForEvents(1);
 #endif
     }
 }
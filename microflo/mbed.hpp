@@ -15,9 +15,11 @@ public:
 private:
     Timer timer;
     Serial usbSerial;
+    LocalFileSystem localFileSystem; // graph storage, on the USB drive
 public:
     MbedIO()
         : usbSerial(USBTX, USBRX)
+        , localFileSystem("local")
     {
         timer.start();
     }
@@ -35,6 +37,9 @@ public:
     virtual void SerialWrite(int serialDevice, unsigned char b) {
         usbSerial.putc(b);
     }
+    virtual long SerialWriteAvailable(int serialDevice) {
+        return usbSerial.writeable() ? 1 : 0;
+    }
 
     // Pin config
     virtual void PinSetMode(int pin, IO::PinMode mode) {
@@ -84,5 +89,50 @@ public:
                                          IOInterruptFunction func, void *user) {
         MICROFLO_DEBUG(debug, DebugLevelError, DebugIoOperationNotImplemented);
     }
+
+    // Storage
+    // GRAPH.BIN on the mbed USB drive. Erasing a bank leaves a blank header, and the file is padded
+    // up to it, so later writes never seek past the end
+    virtual long StorageSize() {
+        return 16*1024;
+    }
+    virtual bool StorageErase(long offset, long length) {
+        FILE *f = fopen(storagePath, "r+b");
+        if (!f) {
+            f = fopen(storagePath, "w+b");
+        }
+        if (!f) {
+            return false;
+        }
+        const uint8_t blank[8] = { 0 };
+        bool ok = fseek(f, 0, SEEK_END) == 0;
+        for (long end = ftell(f); ok && end < offset; end += sizeof(blank)) {
+            ok = fwrite(blank, 1, sizeof(blank), f) == sizeof(blank);
+        }
+        ok = ok && fseek(f, offset, SEEK_SET) == 0 && fwrite(blank, 1, sizeof(blank), f) == sizeof(blank);
+        return (fclose(f) == 0) && ok;
+    }
+    virtual bool StorageWrite(long offset, const uint8_t *data, uint8_t length) {
+        FILE *f = fopen(storagePath, "r+b");
+        if (!f) {
+            return false;
+        }
+        const bool ok = fseek(f, offset, SEEK_SET) == 0 && fwrite(data, 1, length, f) == length;
+        return (fclose(f) == 0) && ok;
+    }
+    virtual bool StorageRead(long offset, uint8_t *data, uint8_t length) {
+        FILE *f = fopen(storagePath, "rb");
+        if (!f) {
+            return false;
+        }
+        const bool ok = fseek(f, offset, SEEK_SET) == 0 && fread(data, 1, length, f) == length;
+        fclose(f);
+        return ok;
+    }
+
+private:
+    static const char *storagePath;
 };
 
+const char *MbedIO::storagePath = "/local/GRAPH.BIN";
+
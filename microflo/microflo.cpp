@@ -7,7 +7,7 @@
 
 
 #define MICROFLO_VALID_NODEID(id) \
-   (id >= Network::firstNodeId && id <= lastAddedNodeIndex)
+   (id >= Network::firstNodeId && id < lastAddedNodeIndex && nodes[id])
 
 #ifdef HOST_BUILD
 #include <cstring>
@@ -20,6 +20,9 @@
 
 
 static const char MICROFLO_GRAPH_MAGIC[] = { 'u','C','/','F','l','o', '0', '1' };
+static const char MICROFLO_GRAPH_MAGIC_COMPACT[] = { 'u','C','/','F','l','o', '0', '2' };
+static const uint8_t MICROFLO_UPLOAD_BLOCK_START = 0xB1;
+static const char MICROFLO_GRAPH_IMAGE_MAGIC[] = { 'u','C','/','F','l','o', 'G', '1' };
 
 bool Packet::asBool() const {
     if (msg == MsgBoolean) {
@@ -108,7 +111,40 @@ HostCommunication::HostCommunication()
     , transport(0)
     , currentByte(0)
     , state(LookForHeader)
-{}
+    , framing(FramingFixed)
+    , cobsRemaining(0)
+    , cobsZeroPending(false)
+    , frameInvalid(false)
+    , outLength(0)
+    , batchRuns(0)
+    , batchPackets(0)
+    , batchFromStream(false)
+    , uploadPos(0)
+    , uploadMagicPos(0)
+    , uploadBlockCrc(0)
+    , uploadImageCrc(0)
+    , uploadBase(0)
+    , uploadReceived(0)
+    , uploadGraphEnded(false)
+    , telemetryEncoding(TelemetryEncodingPacket)
+    , keyframeInterval(16)
+    , nextEvicted(0)
+    , telemetryLength(0)
+    , storage(0)
+    , storing(false)
+    , loadingStored(false)
+    , storedLength(0)
+    , storedCrc(0)
+    , storeBuffered(0)
+    , storeBank(0)
+    , storeSequence(0)
+    , debugFirst(0)
+    , debugQueued(0)
+    , debugDropped(0)
+{
+    resetTelemetry();
+    resetStreams();
+}
 
 void HostCommunication::setup(Network *net, HostTransport *t) {
     network = net;
@@ -119,6 +155,21 @@ void HostCommunication::setup(Network *net, HostTransport *t) {
 
 void HostCommunication::parseByte(char b) {
 
+    if (state == ParseUpload) {
+        parseUploadByte(b);
+        return;
+    }
+
+    if (state == ParseCompactCmd) {
+        parseCompactByte(b);
+        return;
+    }
+
+    if (batchRuns > 0) {
+        parseBatchByte(b);
+        return;
+    }
+
     buffer[currentByte++] = b;
 
     if (state == ParseHeader) {
@@ -126,7 +177,14 @@ void HostCommunication::parseByte(char b) {
         if (currentByte == sizeof(MICROFLO_GRAPH_MAGIC)) {
 
             if (memcmp(buffer, MICROFLO_GRAPH_MAGIC, sizeof(MICROFLO_GRAPH_MAGIC)) == 0) {
+                framing = FramingFixed;
                 state = ParseCmd;
+            } else if (memcmp(buffer, MICROFLO_GRAPH_MAGIC_COMPACT, sizeof(MICROFLO_GRAPH_MAGIC_COMPACT)) == 0) {
+                framing = FramingCompact;
+                cobsRemaining = 0;
+                cobsZeroPending = false;
+                frameInvalid = false;
+                state = ParseCompactCmd;
             } else {
                 MICROFLO_DEBUG(network, DebugLevelError, DebugMagicMismatch);
                 state = Invalid;
@@ -136,8 +194,8 @@ void HostCommunication::parseByte(char b) {
     } else if (state == ParseCmd) {
         MICROFLO_DEBUG(network, DebugLevelVeryDetailed, DebugParseCommand);
         if (currentByte == MICROFLO_CMD_SIZE) {
-            parseCmd();
             currentByte = 0;
+            parseCmd();
         }
     } else if (state == LookForHeader) {
         MICROFLO_DEBUG(network, DebugLevelVeryDetailed, DebugParseLookForHeader);
@@ -162,13 +220,569 @@ void HostCommunication::parseByte(char b) {
     }
 }
 
+// Same as parseByte() for each byte, but whole commands
+// are parsed directly from @data when possible
+void HostCommunication::parseBytes(const uint8_t *data, size_t length) {
+    size_t i = 0;
+    while (i < length) {
+        const bool wholeCommand = state == ParseCmd && batchRuns == 0 && currentByte == 0
+                && length-i >= MICROFLO_CMD_SIZE;
+        if (wholeCommand) {
+            MICROFLO_DEBUG(network, DebugLevelVeryDetailed, DebugParseCommand);
+            memcpy(buffer, data+i, MICROFLO_CMD_SIZE);
+            i += MICROFLO_CMD_SIZE;
+            parseCmd();
+        } else {
+            parseByte(data[i++]);
+        }
+    }
+}
+
+// COBS decoding, see http://en.wikipedia.org/wiki/Consistent_Overhead_Byte_Stuffing
+// 0x00 only occurs as frame delimiter, so a corrupt frame is dropped and
+// parsing resumes with the next one
+void HostCommunication::parseCompactByte(uint8_t b) {
+    if (b == 0x00) {
+        if (currentByte > 0 && !frameInvalid && cobsRemaining == 0 && batchRuns == 0) {
+            for (int i=currentByte; i<(int)MICROFLO_CMD_SIZE; i++) {
+                buffer[i] = 0x00;
+            }
+            parseCmd();
+        } else if (currentByte > 0 || batchRuns > 0) {
+            MICROFLO_DEBUG(network, DebugLevelError, DebugFramingError);
+        }
+        currentByte = 0;
+        cobsRemaining = 0;
+        cobsZeroPending = false;
+        frameInvalid = false;
+        batchRuns = 0;
+        batchPackets = 0;
+        return;
+    }
+
+    if (frameInvalid) {
+        return;
+    }
+
+    const bool codeByte = (cobsRemaining == 0);
+    const bool haveData = !codeByte || cobsZeroPending;
+    const uint8_t data = codeByte ? 0x00 : b;
+    if (codeByte) {
+        cobsRemaining = b-1;
+        cobsZeroPending = (b != 0xFF);
+    } else {
+        cobsRemaining--;
+    }
+    if (!haveData) {
+        return;
+    }
+
+    if (batchRuns > 0) {
+        parseBatchByte(data);
+        return;
+    }
+    if (currentByte >= MICROFLO_CMD_SIZE) {
+        frameInvalid = true;
+        return;
+    }
+    buffer[currentByte++] = data;
+    if (currentByte == MICROFLO_CMD_SIZE && (buffer[0] == GraphCmdSendPackets || buffer[0] == GraphCmdStreamData)) {
+        // Batched packets follow in the same frame
+        currentByte = 0;
+        parseCmd();
+    }
+}
+
+// Size of packet payload as sent by host, -1 if type cannot be sent
+static int8_t packetPayloadSize(Msg type) {
+    switch (type) {
+    case MsgVoid:
+    case MsgBracketStart:
+    case MsgBracketEnd:
+        return 0;
+    case MsgByte:
+    case MsgBoolean:
+        return 1;
+    case MsgInteger:
+        return 4;
+    default:
+        return -1;
+    }
+}
+
+static Packet packetFromPayload(Msg type, const unsigned char *payload) {
+    if (type == MsgInteger) {
+        const long val = payload[0] + 256L*payload[1] + 256L*256*payload[2] + 256L*256*256*payload[3];
+        return Packet(val);
+    } else if (type == MsgByte) {
+        const unsigned char b = payload[0];
+        return Packet(b);
+    } else if (type == MsgBoolean) {
+        const bool b = !(payload[0] == 0);
+        return Packet(b);
+    }
+    return Packet(type);
+}
+
+// The packets of a SendPackets command follow it directly, as runs of
+// [target, targetPort, packetType, count] each followed by count payloads.
+// Packets are queued as soon as their payload is complete
+void HostCommunication::parseBatchByte(uint8_t b) {
+    if (storing) {
+        storeBytes(&b, 1);
+    }
+    buffer[currentByte++] = b;
+    if (batchPackets == 0) {
+        if (currentByte < 4) {
+            return;
+        }
+        batchPackets = buffer[3];
+        if (packetPayloadSize((Msg)buffer[2]) < 0) {
+            MICROFLO_DEBUG(network, DebugLevelError, DebugParserUnknownPacketType);
+            batchRuns = 0;
+            batchPackets = 0;
+            currentByte = 0;
+            if (framing == FramingCompact) {
+                frameInvalid = true;
+            } else {
+                state = Invalid;
+            }
+            return;
+        }
+    }
+
+    const Msg type = (Msg)buffer[2];
+    const int8_t size = packetPayloadSize(type);
+    while (batchPackets > 0 && currentByte == 4+size) {
+        network->sendMessage(buffer[0], buffer[1], packetFromPayload(type, buffer+4), batchFromStream);
+        batchPackets--;
+        currentByte = 4;
+    }
+    if (batchPackets == 0) {
+        batchRuns--;
+        currentByte = 0;
+    }
+}
+
+// Bind @stream to @port of node. Host gets @window credits, or as many as the
+// message queue can take. Sending more packets than credits risks queue overflow.
+// Host may open a stream again to recover credits lost in transit
+void HostCommunication::openStream(uint8_t stream, MicroFlo::NodeId nodeId, MicroFlo::PortId port, uint8_t window) {
+    int limit = (MICROFLO_MAX_MESSAGES < MICROFLO_MAX_WIDE_MESSAGES) ? MICROFLO_MAX_MESSAGES : MICROFLO_MAX_WIDE_MESSAGES;
+    limit = (limit/2 > 255) ? 255 : (limit/2 < 1) ? 1 : limit/2;
+    Component *node = (nodeId >= Network::firstNodeId && nodeId < network->lastAddedNodeIndex)
+            ? network->nodes[nodeId] : 0;
+    // Credit is matched against where packets are delivered, a child for SubGraph inports
+    MicroFlo::PortId nodePort = port;
+    node = node ? network->deliveryTarget(node, &nodePort) : 0;
+    if (stream >= MICROFLO_STREAMS || !node) {
+        MICROFLO_DEBUG(network, DebugLevelError, DebugStreamInvalid);
+        window = 0;
+    } else {
+        InputStream &s = streams[stream];
+        s.node = node;
+        s.port = nodePort;
+        s.window = (window == 0 || window > limit) ? limit : window;
+        s.outstanding = 0;
+        s.consumed = 0;
+        window = s.window;
+    }
+    sendCommandByte(GraphCmdStreamOpened);
+    sendCommandByte(stream);
+    sendCommandByte(nodeId);
+    sendCommandByte(port);
+    sendCommandByte(window);
+    finishCommand();
+}
+
+// StreamData is [stream, packetType, count], followed by count payloads.
+// Parsed like a SendPackets run to the port of the stream
+void HostCommunication::streamData() {
+    const uint8_t stream = buffer[1];
+    const Msg type = (Msg)buffer[2];
+    const uint8_t count = buffer[3];
+    const int8_t size = packetPayloadSize(type);
+    if (size < 0) {
+        MICROFLO_DEBUG(network, DebugLevelError, DebugParserUnknownPacketType);
+        if (framing == FramingCompact) {
+            frameInvalid = true;
+        } else {
+            state = Invalid;
+        }
+        return;
+    }
+
+    InputStream *s = (stream < MICROFLO_STREAMS && streams[stream].node) ? &streams[stream] : 0;
+    if (!s) {
+        // Payloads must still be parsed, network drops packets to node 0
+        MICROFLO_DEBUG(network, DebugLevelError, DebugStreamInvalid);
+    } else {
+        s->outstanding = (s->outstanding+count > 255) ? 255 : s->outstanding+count;
+    }
+    buffer[0] = s ? s->node->id() : 0;
+    buffer[1] = s ? s->port : 0;
+    if (size == 0) {
+        for (int i=0; i<count; i++) {
+            network->sendMessage(buffer[0], buffer[1], packetFromPayload(type, buffer+4), true);
+        }
+    } else if (count > 0) {
+        batchRuns = 1;
+        batchPackets = count;
+        batchFromStream = true;
+        currentByte = 4;
+    }
+}
+
+void HostCommunication::resetStreams() {
+    for (int i=0; i<MICROFLO_STREAMS; i++) {
+        streams[i].node = 0;
+    }
+}
+
+// CRC-16-CCITT, polynomial 0x1021
+static uint16_t crc16Update(uint16_t crc, uint8_t b) {
+    crc ^= (uint16_t)b << 8;
+    for (int i=0; i<8; i++) {
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    }
+    return crc;
+}
+
+// Block upload: after BeginUpload the graph arrives as blocks
+// [start, seq, length, crc lo, crc hi, payload...], CRC over seq, length and payload.
+// Verified blocks are acked, and parsed in sequence order as soon as all earlier ones
+// have arrived, so host may keep MICROFLO_UPLOAD_WINDOW blocks in flight and only resend lost ones.
+// A block with length 0 ends the upload, its CRC is that of the whole graph image.
+// The network is only started when it matches.
+void HostCommunication::parseUploadByte(uint8_t b) {
+    if (uploadPos == 0) {
+        // Between blocks. Host gave up on upload if it starts a new session
+        if (b == MICROFLO_UPLOAD_BLOCK_START) {
+            uploadPos = 1;
+            uploadMagicPos = 0;
+        } else if (b == MICROFLO_GRAPH_MAGIC[uploadMagicPos]) {
+            if (++uploadMagicPos == sizeof(MICROFLO_GRAPH_MAGIC)-1) {
+                memcpy(buffer, MICROFLO_GRAPH_MAGIC, uploadMagicPos);
+                currentByte = uploadMagicPos;
+                uploadMagicPos = 0;
+                batchRuns = 0;
+                batchPackets = 0;
+                state = ParseHeader;
+            }
+        } else {
+            uploadMagicPos = (b == MICROFLO_GRAPH_MAGIC[0]) ? 1 : 0;
+        }
+        return;
+    }
+
+    if (uploadPos < 5) {
+        uploadHeader[uploadPos-1] = b;
+        uploadPos++;
+        if (uploadPos == 3) {
+            uploadBlockCrc = crc16Update(crc16Update(0xFFFF, uploadHeader[0]), uploadHeader[1]);
+            if (uploadHeader[1] > MICROFLO_UPLOAD_BLOCK_SIZE) {
+                MICROFLO_DEBUG(network, DebugLevelError, DebugUploadBlockInvalid);
+                uploadPos = 0;
+            }
+        } else if (uploadPos == 5 && uploadHeader[1] == 0) {
+            finishUploadBlock();
+        }
+        return;
+    }
+
+    // Payload. Only stored if block is in window and not already received
+    const uint8_t seq = uploadHeader[0];
+    const uint8_t slot = seq % MICROFLO_UPLOAD_WINDOW;
+    const uint8_t offset = seq - uploadBase;
+    if (offset < MICROFLO_UPLOAD_WINDOW && !(uploadReceived & (1 << slot))) {
+        uploadWindow[slot][uploadPos-5] = b;
+    }
+    uploadBlockCrc = crc16Update(uploadBlockCrc, b);
+    uploadPos++;
+    if (uploadPos-5 == uploadHeader[1]) {
+        finishUploadBlock();
+    }
+}
+
+void HostCommunication::finishUploadBlock() {
+    const uint8_t seq = uploadHeader[0];
+    const uint8_t length = uploadHeader[1];
+    const uint16_t crc = uploadHeader[2] + 256*uploadHeader[3];
+    uploadPos = 0;
+
+    if (length == 0) {
+        const bool valid = uploadGraphEnded && seq == uploadBase && crc == uploadImageCrc;
+        sendCommandByte(GraphCmdUploadVerified);
+        sendCommandByte(valid);
+        finishCommand();
+        state = LookForHeader;
+        finishStoredGraph(valid);
+        if (valid) {
+            network->start();
+        } else {
+            MICROFLO_DEBUG(network, DebugLevelError, DebugUploadBlockInvalid);
+            network->reset();
+        }
+        return;
+    }
+
+    // Blocks before the window have already been parsed, host just missed the ack
+    const uint8_t offset = seq - uploadBase;
+    const uint8_t slot = seq % MICROFLO_UPLOAD_WINDOW;
+    const bool valid = crc == uploadBlockCrc;
+    const bool accepted = valid && (offset < MICROFLO_UPLOAD_WINDOW || offset >= 256-MICROFLO_UPLOAD_WINDOW);
+    if (!valid) {
+        MICROFLO_DEBUG(network, DebugLevelError, DebugUploadBlockInvalid);
+    }
+    if (accepted && offset < MICROFLO_UPLOAD_WINDOW) {
+        uploadLength[slot] = length;
+        uploadReceived |= (1 << slot);
+    }
+    sendCommandByte(GraphCmdUploadBlockAck);
+    sendCommandByte(seq);
+    sendCommandByte(accepted);
+    finishCommand();
+
+    while (state == ParseUpload && (uploadReceived & (1 << (uploadBase % MICROFLO_UPLOAD_WINDOW)))) {
+        const uint8_t s = uploadBase % MICROFLO_UPLOAD_WINDOW;
+        for (int i=0; i<uploadLength[s]; i++) {
+            uploadImageCrc = crc16Update(uploadImageCrc, uploadWindow[s][i]);
+            parseImageByte(uploadWindow[s][i]);
+        }
+        uploadReceived &= ~(1 << s);
+        uploadBase++;
+    }
+}
+
+// Graph image uses fixed framing, but commands may span blocks
+void HostCommunication::parseImageByte(uint8_t b) {
+    if (batchRuns > 0) {
+        parseBatchByte(b);
+        return;
+    }
+    buffer[currentByte++] = b;
+    if (currentByte == MICROFLO_CMD_SIZE) {
+        parseCmd();
+        currentByte = 0;
+    }
+}
+
+// Stored graph: storage is split in two banks, each with a header
+// [ 'M', 'F', version, sequence, length lo, length hi, crc lo, crc hi ]
+// followed by the graph commands from Reset to End as they were parsed, zero padded.
+// A new graph goes to the bank not holding the current one, and its header is written last,
+// once the graph was accepted. An aborted or failed upload leaves the previous graph in place.
+// The bank with the newest valid graph is the one loaded at boot
+static const uint8_t MICROFLO_STORAGE_VERSION = 2;
+
+// Commands that build the graph, and are stored
+static bool isGraphCommand(GraphCmd cmd) {
+    return cmd == GraphCmdReset || cmd == GraphCmdCreateComponent || cmd == GraphCmdConnectNodes
+        || cmd == GraphCmdSendPacket || cmd == GraphCmdSendPackets || cmd == GraphCmdConnectSubgraphPort
+        || cmd == GraphCmdConfigureDebug || cmd == GraphCmdEnd;
+}
+
+void HostCommunication::setStorage(IO *s) {
+    storage = s;
+    storing = false;
+}
+
+long HostCommunication::storageBankSize() {
+    return (storage->StorageSize()/2) & ~(long)(MICROFLO_CMD_SIZE-1);
+}
+
+// Bank with the newest graph that has a valid header and CRC, or -1 if none
+int HostCommunication::activeStorageBank(uint8_t *sequence, uint16_t *length) {
+    int active = -1;
+    for (int bank=0; bank<2; bank++) {
+        const long base = bank*storageBankSize();
+        uint8_t chunk[MICROFLO_CMD_SIZE];
+        if (!storage->StorageRead(base, chunk, sizeof(chunk))) {
+            continue;
+        }
+        const uint16_t len = chunk[4] + 256*chunk[5];
+        const uint16_t crc = chunk[6] + 256*chunk[7];
+        const uint8_t seq = chunk[3];
+        if (chunk[0] != 'M' || chunk[1] != 'F' || chunk[2] != MICROFLO_STORAGE_VERSION
+                || len % MICROFLO_CMD_SIZE || (long)MICROFLO_CMD_SIZE + len > storageBankSize()
+                || (active >= 0 && (int8_t)(seq - *sequence) <= 0)) {
+            continue;
+        }
+        uint16_t actual = 0xFFFF;
+        bool read = true;
+        for (uint16_t offset=0; read && offset<len; offset+=sizeof(chunk)) {
+            read = storage->StorageRead(base+MICROFLO_CMD_SIZE+offset, chunk, sizeof(chunk));
+            for (size_t i=0; i<sizeof(chunk); i++) {
+                actual = crc16Update(actual, chunk[i]);
+            }
+        }
+        if (!read || actual != crc) {
+            MICROFLO_DEBUG(network, DebugLevelError, DebugStorageFailed);
+            continue;
+        }
+        active = bank;
+        *sequence = seq;
+        *length = len;
+    }
+    return active;
+}
+
+void HostCommunication::startStoredGraph() {
+    uint8_t sequence = 0;
+    uint16_t length = 0;
+    const int active = activeStorageBank(&sequence, &length);
+    storeBank = (active == 0) ? 1 : 0;
+    storeSequence = (active < 0) ? 0 : sequence+1;
+    const long bankSize = storageBankSize();
+    storing = bankSize > (long)MICROFLO_CMD_SIZE && storage->StorageErase(storeBank*bankSize, bankSize);
+    if (!storing) {
+        MICROFLO_DEBUG(network, DebugLevelError, DebugStorageFailed);
+    }
+    storedLength = 0;
+    storedCrc = 0xFFFF;
+    storeBuffered = 0;
+}
+
+void HostCommunication::storeBytes(const uint8_t *data, uint8_t length) {
+    for (int i=0; i<length && storing; i++) {
+        storedCrc = crc16Update(storedCrc, data[i]);
+        storeBuffer[storeBuffered++] = data[i];
+        if (storeBuffered < MICROFLO_CMD_SIZE) {
+            continue;
+        }
+        const long offset = (long)MICROFLO_CMD_SIZE + storedLength;
+        if (offset + (long)MICROFLO_CMD_SIZE > storageBankSize() || storedLength > 0xFFFF-MICROFLO_CMD_SIZE) {
+            MICROFLO_DEBUG(network, DebugLevelError, DebugStorageFull);
+            storing = false;
+        } else if (!storage->StorageWrite(storeBank*storageBankSize() + offset, storeBuffer, MICROFLO_CMD_SIZE)) {
+            MICROFLO_DEBUG(network, DebugLevelError, DebugStorageFailed);
+            storing = false;
+        }
+        storedLength += MICROFLO_CMD_SIZE;
+        storeBuffered = 0;
+    }
+}
+
+// Writes header if graph was accepted, making it the one loaded at boot
+void HostCommunication::finishStoredGraph(bool valid) {
+    if (!storing) {
+        return;
+    }
+    const uint8_t zero = 0x00;
+    while (storing && storeBuffered > 0) {
+        storeBytes(&zero, 1);
+    }
+    if (!storing || !valid) {
+        storing = false;
+        return;
+    }
+    storing = false;
+
+    const uint8_t header[MICROFLO_CMD_SIZE] = {
+        'M', 'F', MICROFLO_STORAGE_VERSION, storeSequence,
+        (uint8_t)(storedLength>>0), (uint8_t)(storedLength>>8),
+        (uint8_t)(storedCrc>>0), (uint8_t)(storedCrc>>8)
+    };
+    if (!storage->StorageWrite(storeBank*storageBankSize(), header, sizeof(header))) {
+        MICROFLO_DEBUG(network, DebugLevelError, DebugStorageFailed);
+    }
+}
+
+// Precompiled graph image, see graphImageFromCmdStream() in commandstream.js:
+// [magic, crc, nodes, edges, subgraph ports] (16 bit), then tables with the arguments of
+// CreateComponent (2 bytes), ConnectNodes (4) and ConnectSubgraphPort (5), and last the other
+// commands of the graph. Tables are applied directly, only the remaining commands are parsed
+bool HostCommunication::loadGraphImage(const uint8_t *image, size_t length) {
+    const size_t headerSize = sizeof(MICROFLO_GRAPH_IMAGE_MAGIC)+8;
+    if (length < headerSize || memcmp(image, MICROFLO_GRAPH_IMAGE_MAGIC, sizeof(MICROFLO_GRAPH_IMAGE_MAGIC)) != 0) {
+        MICROFLO_DEBUG(network, DebugLevelError, DebugGraphImageInvalid);
+        return false;
+    }
+    const uint8_t *h = image + sizeof(MICROFLO_GRAPH_IMAGE_MAGIC);
+    const uint16_t crc = h[0] + 256*h[1];
+    const size_t nodes = h[2] + 256*h[3];
+    const size_t edges = h[4] + 256*h[5];
+    const size_t ports = h[6] + 256*h[7];
+    uint16_t actual = 0xFFFF;
+    for (size_t i=headerSize; i<length; i++) {
+        actual = crc16Update(actual, image[i]);
+    }
+    if (actual != crc || headerSize + nodes*2 + edges*4 + ports*5 > length) {
+        MICROFLO_DEBUG(network, DebugLevelError, DebugGraphImageInvalid);
+        return false;
+    }
+
+    resetStreams();
+    network->reset();
+    const uint8_t *p = image + headerSize;
+    for (size_t i=0; i<nodes; i++, p+=2) {
+        network->addNode(Component::create((ComponentId)p[0]), p[1]);
+    }
+    for (size_t i=0; i<edges; i++, p+=4) {
+        network->connect(p[0], p[2], p[1], p[3]);
+    }
+    for (size_t i=0; i<ports; i++, p+=5) {
+        network->connectSubgraph(p[0], p[1], p[2], p[3], p[4]);
+    }
+
+    // Remaining commands end with End, which starts the network
+    state = LookForHeader;
+    currentByte = 0;
+    batchRuns = 0;
+    batchPackets = 0;
+    parseBytes((const uint8_t *)MICROFLO_GRAPH_MAGIC, sizeof(MICROFLO_GRAPH_MAGIC));
+    parseBytes(p, image+length-p);
+    return true;
+}
+
+bool HostCommunication::loadStoredGraph() {
+    uint8_t sequence = 0;
+    uint16_t length = 0;
+    const int bank = storage ? activeStorageBank(&sequence, &length) : -1;
+    if (bank < 0) {
+        return false;
+    }
+
+    // All of it was verified by activeStorageBank(), before building any of the network
+    uint8_t chunk[MICROFLO_CMD_SIZE];
+    const long base = bank*storageBankSize() + MICROFLO_CMD_SIZE;
+    loadingStored = true; // Reset in it must not start storing
+    parseBytes((const uint8_t *)MICROFLO_GRAPH_MAGIC, sizeof(MICROFLO_GRAPH_MAGIC));
+    for (uint16_t offset=0; offset<length; offset+=sizeof(chunk)) {
+        storage->StorageRead(base+offset, chunk, sizeof(chunk));
+        parseBytes(chunk, sizeof(chunk));
+    }
+    loadingStored = false;
+    return true;
+}
+
 void HostCommunication::parseCmd() {
 
+    if (memcmp(buffer, MICROFLO_GRAPH_MAGIC, sizeof(MICROFLO_GRAPH_MAGIC)) == 0) {
+        // Host tools may prefix commands to a running network with the magic too
+        return;
+    }
+
     GraphCmd cmd = (GraphCmd)buffer[0];
+    if (cmd == GraphCmdReset && storage && !loadingStored) {
+        startStoredGraph();
+    }
+    if (storing && isGraphCommand(cmd)) {
+        storeBytes(buffer, MICROFLO_CMD_SIZE);
+    }
+
     if (cmd == GraphCmdEnd) {
-        network->start();
-        state = LookForHeader;
+        if (state == ParseUpload) {
+            // Started once whole upload has been verified
+            uploadGraphEnded = true;
+        } else {
+            finishStoredGraph(true);
+            network->start();
+            state = LookForHeader;
+        }
     } else if (cmd == GraphCmdReset) {
+        resetTelemetry();
+        resetStreams();
         network->reset();
     } else if (cmd == GraphCmdCreateComponent) {
         const ComponentId id = (ComponentId)buffer[1];
@@ -178,6 +792,8 @@ void HostCommunication::parseCmd() {
         Component *c = Component::create(id);
         MICROFLO_DEBUG(network, DebugLevelDetailed, DebugComponentCreateEnd);
         network->addNode(c, parentId);
+    } else if (cmd == GraphCmdRemoveNode) {
+        network->removeNode(buffer[1]);
     } else if (cmd == GraphCmdConnectNodes) {
         // FIXME: validate
         MICROFLO_DEBUG(network, DebugLevelDetailed, DebugConnectNodesStart);
@@ -186,36 +802,70 @@ void HostCommunication::parseCmd() {
         const int srcPort = (unsigned int)buffer[3];
         const int targetPort = (unsigned int)buffer[4];
         network->connect(src, srcPort, target, targetPort);
+    } else if (cmd == GraphCmdDisconnectNodes) {
+        network->disconnect(buffer[1], buffer[2]);
     } else if (cmd == GraphCmdSendPacket) {
         // FIXME: validate
         const int target = (unsigned int)buffer[1];
         const int targetPort = (unsigned int)buffer[2];
         const Msg packetType = (Msg)buffer[3];
-        if (packetType == MsgBracketStart || packetType == MsgBracketEnd
-                || packetType == MsgVoid) {
-            network->sendMessage(target, targetPort, Packet(packetType));
-        } else if (packetType == MsgInteger) {
-            const long val = buffer[4] + 256*buffer[5] + 256*256*buffer[6] + 256*256*256*buffer[7];
-            network->sendMessage(target, targetPort, Packet(val));
-        } else if (packetType == MsgByte) {
-            const unsigned char b = buffer[4];
-            network->sendMessage(target, targetPort, Packet(b));
-        } else if (packetType == MsgBoolean) {
-            const bool b = !(buffer[4] == 0);
-            network->sendMessage(target, targetPort, Packet(b));
+        if (packetPayloadSize(packetType) >= 0) {
+            network->sendMessage(target, targetPort, packetFromPayload(packetType, buffer+4));
         } else {
             MICROFLO_DEBUG(network, DebugLevelError, DebugParserUnknownPacketType);
         }
 
+    } else if (cmd == GraphCmdBeginUpload) {
+        // Graph must not run half-updated
+        resetStreams();
+        network->reset();
+        uploadPos = 0;
+        uploadMagicPos = 0;
+        uploadImageCrc = 0xFFFF;
+        uploadBase = 0;
+        uploadReceived = 0;
+        uploadGraphEnded = false;
+        batchRuns = 0;
+        batchPackets = 0;
+        state = ParseUpload;
+        sendCommandByte(GraphCmdUploadReady);
+        sendCommandByte(MICROFLO_UPLOAD_WINDOW);
+        sendCommandByte(MICROFLO_UPLOAD_BLOCK_SIZE);
+        finishCommand();
+
+    } else if (cmd == GraphCmdSendPackets) {
+        // Packets follow the command, see parseBatchByte()
+        batchRuns = buffer[1];
+        batchPackets = 0;
+        batchFromStream = false;
+
+    } else if (cmd == GraphCmdOpenStream) {
+        openStream(buffer[1], buffer[2], buffer[3], buffer[4]);
+
+    } else if (cmd == GraphCmdStreamData) {
+        streamData();
+
     } else if (cmd == GraphCmdConfigureDebug) {
         const DebugLevel l = (DebugLevel)buffer[1];
         network->setDebugLevel(l);
 
+    } else if (cmd == GraphCmdConfigureTelemetry) {
+        flushTelemetry();
+        telemetryEncoding = (TelemetryEncoding)buffer[1];
+        keyframeInterval = buffer[2] ? buffer[2] : 16;
+        resetTelemetry();
+        sendCommandByte(GraphCmdTelemetryChanged);
+        sendCommandByte(telemetryEncoding);
+        sendCommandByte(keyframeInterval);
+        finishCommand();
+
     } else if (cmd == GraphCmdSubscribeToPort) {
         const int nodeId = (unsigned int)buffer[1];
         const int portId = (unsigned int)buffer[2];
         const bool enable = (bool)buffer[3];
-        network->subscribeToPort(nodeId, portId, enable);
+        const SubscriptionMode mode = (SubscriptionMode)buffer[4];
+        const uint16_t period = buffer[5] + 256*buffer[6];
+        network->subscribeToPort(nodeId, portId, enable, mode, period);
 
     } else if (cmd == GraphCmdConnectSubgraphPort) {
         // FIXME: validate
@@ -226,6 +876,10 @@ void HostCommunication::parseCmd() {
         const int childPort = (unsigned int)buffer[5];
         network->connectSubgraph(isOutput, subgraphNode, subgraphPort, childNode, childPort);
 
+    } else if (cmd == GraphCmdQueryStackUsage) {
+        const long alarmThreshold = buffer[1] + 256*buffer[2];
+        network->queryStackUsage(alarmThreshold);
+
     } else if (cmd >= GraphCmdInvalid) {
         MICROFLO_DEBUG(network, DebugLevelError, DebugParserInvalidCommand);
         // state = Invalid; // XXX: or maybe just ignore?
@@ -265,16 +919,24 @@ void Component::setNetwork(Network *net, int n, IO *i) {
 
 Network::Network(IO *io)
     : lastAddedNodeIndex(Network::firstNodeId)
+    , freeNodeCount(0)
     , messageWriteIndex(0)
     , messageReadIndex(0)
+    , wideWriteIndex(0)
+    , wideQueued(0)
     , notificationHandler(0)
     , io(io)
     , state(Stopped)
     , debugLevel(DebugLevelError)
+    , stackAlarmThreshold(0)
+    , stackAlarmRaised(false)
 {
     for (int i=0; i<MICROFLO_MAX_NODES; i++) {
         nodes[i] = 0;
     }
+    for (int i=0; i<MICROFLO_MAX_SUBSCRIPTIONS; i++) {
+        subscriptions[i].node = 0;
+    }
 }
 
 void Network::setNotificationHandler(NetworkNotificationHandler *handler) {
@@ -288,18 +950,45 @@ void Network::deliverMessages(int firstIndex, int lastIndex) {
         }
 
         for (int i=firstIndex; i<=lastIndex; i++) {
-            Component *target = messages[i].target;
-            if (!target) {
-                // FIXME: this should not happen
+            const bool fromStream = messages[i].fromStream;
+            const Message msg = dequeueMessage(i);
+            if (!msg.target) {
+                // Target was removed after message was queued
                 continue;
             }
-            target->process(messages[i].pkg, messages[i].targetPort);
+            msg.target->process(msg.pkg, msg.targetPort);
             if (notificationHandler) {
-                notificationHandler->packetDelivered(i, messages[i]);
+                notificationHandler->packetDelivered(i, msg, fromStream);
             }
         }
 }
 
+// Also releases the wide value slot, if any. Must be called in queue order
+Message Network::dequeueMessage(int index) {
+    const QueuedMessage &q = messages[index];
+    Message msg;
+    msg.target = q.target;
+    msg.targetPort = q.targetPort;
+
+    const Msg type = (Msg)q.type;
+    if (type == MsgInteger) {
+        msg.pkg = Packet(wideValues[q.value].lng);
+        wideQueued--;
+    } else if (type == MsgFloat) {
+        msg.pkg = Packet(wideValues[q.value].flt);
+        wideQueued--;
+    } else if (type == MsgBoolean) {
+        msg.pkg = Packet((bool)q.value);
+    } else if (type == MsgByte) {
+        msg.pkg = Packet((unsigned char)q.value);
+    } else if (type == MsgAscii) {
+        msg.pkg = Packet((char)q.value);
+    } else {
+        msg.pkg = Packet(type);
+    }
+    return msg;
+}
+
 void Network::processMessages() {
     // Messages may be emitted during delivery, so copy the range we intend to deliver
     const int readIndex = messageReadIndex;
@@ -316,16 +1005,11 @@ void Network::processMessages() {
 }
 
 void Network::sendMessage(Component *target, MicroFlo::PortId targetPort, const Packet &pkg,
-                          Component *sender, MicroFlo::PortId senderPort) {
+                          Component *sender, MicroFlo::PortId senderPort, bool fromStream) {
     if (!target) {
         return;
     }
 
-    if (messageWriteIndex > MICROFLO_MAX_MESSAGES-1) {
-        messageWriteIndex = 0;
-    }
-    const int msgIndex = messageWriteIndex++;
-
     const bool senderIsChild = sender && sender->parentNodeId >= Network::firstNodeId;
     if (senderIsChild) {
         Components::SubGraph *parent = (Components::SubGraph *)nodes[sender->parentNodeId];
@@ -337,33 +1021,82 @@ void Network::sendMessage(Component *target, MicroFlo::PortId targetPort, const
         }
     }
 
-    const bool targetIsSubGraph = target->componentId == IdSubGraph;
-    if (targetIsSubGraph) {
-        Components::SubGraph *targetSubGraph = (Components::SubGraph *)target;
-        // Redirect input message from, send to desired port on child
-        // FIXME: should we change @sender / @senderPort, for debugging?
-        target = targetSubGraph->inputConnections[targetPort].target;
-        targetPort = targetSubGraph->inputConnections[targetPort].targetPort;
+    // FIXME: should we change @sender / @senderPort, for debugging?
+    target = deliveryTarget(target, &targetPort);
+    if (!target) {
+        return;
+    }
+
+    // One slot is kept free, read == write means empty. Overwriting an undelivered
+    // message would lose it, and leak its wide value slot
+    const int msgIndex = (messageWriteIndex > MICROFLO_MAX_MESSAGES-1) ? 0 : messageWriteIndex;
+    if ((msgIndex+1) % MICROFLO_MAX_MESSAGES == messageReadIndex % MICROFLO_MAX_MESSAGES) {
+        MICROFLO_NETWORK_DEBUG(DebugLevelError, DebugMessageQueueFull);
+        return;
     }
 
-    Message &msg = messages[msgIndex];
+    uint8_t value = 0;
+    if (pkg.isNarrow()) {
+        value = pkg.asByte();
+    } else {
+        if (wideQueued >= MICROFLO_MAX_WIDE_MESSAGES) {
+            MICROFLO_NETWORK_DEBUG(DebugLevelError, DebugWideMessagePoolFull);
+            return;
+        }
+        if (wideWriteIndex > MICROFLO_MAX_WIDE_MESSAGES-1) {
+            wideWriteIndex = 0;
+        }
+        value = wideWriteIndex++;
+        wideQueued++;
+        if (pkg.isFloat()) {
+            wideValues[value].flt = pkg.asFloat();
+        } else {
+            wideValues[value].lng = pkg.asInteger();
+        }
+    }
+
+    messageWriteIndex = msgIndex+1;
+
+    QueuedMessage &queued = messages[msgIndex];
+    queued.target = target;
+    queued.targetPort = targetPort;
+    queued.type = pkg.type();
+    queued.fromStream = fromStream;
+    queued.value = value;
+
+    Message msg;
     msg.target = target;
     msg.targetPort = targetPort;
     msg.pkg = pkg;
 
-    const bool sendNotification = sender ? sender->connections[senderPort].subscribed : false;
+    const bool subscribed = sender ? sender->connections[senderPort].subscribed : false;
+    const bool sendNotification = subscribed && subscriptionAccepts(sender, senderPort, pkg);
     if (sendNotification && notificationHandler) {
         notificationHandler->packetSent(msgIndex, msg, sender, senderPort);
     }
 }
 
-void Network::sendMessage(MicroFlo::NodeId targetId, MicroFlo::PortId targetPort, const Packet &pkg) {
+// Input message to a SubGraph goes to the port of the child connected to that inport
+Component *Network::deliveryTarget(Component *target, MicroFlo::PortId *targetPort) {
+    if (target->componentId != IdSubGraph) {
+        return target;
+    }
+    if (*targetPort < 0 || *targetPort >= MICROFLO_SUBGRAPH_MAXPORTS) {
+        return 0;
+    }
+    const Connection &inport = ((Components::SubGraph *)target)->inputConnections[*targetPort];
+    *targetPort = inport.targetPort;
+    return inport.target;
+}
+
+void Network::sendMessage(MicroFlo::NodeId targetId, MicroFlo::PortId targetPort, const Packet &pkg,
+                          bool fromStream) {
     if (!MICROFLO_VALID_NODEID(targetId)) {
-        MICROFLO_DEBUG(this, DebugLevelError, DebugSendMessageInvalidNode);
+        MICROFLO_NETWORK_DEBUG(DebugLevelError, DebugSendMessageInvalidNode);
         return;
     }
 
-    sendMessage(nodes[targetId], targetPort, pkg);
+    sendMessage(nodes[targetId], targetPort, pkg, 0, -1, fromStream);
 }
 
 void Network::runSetup() {
@@ -395,18 +1128,61 @@ void Network::runTick() {
             t->process(Packet(MsgTick), -1);
         }
     }
+
+    reportSubscriptions();
+    checkStackUsage();
+}
+
+void Network::checkStackUsage() {
+    if (stackAlarmThreshold <= 0 || stackAlarmRaised) {
+        return;
+    }
+
+    // Only need to scan up to the threshold to know if it has been crossed
+    const long free = io->StackFreeMinimum(stackAlarmThreshold);
+    if (free >= 0 && free < stackAlarmThreshold) {
+        stackAlarmRaised = true;
+        emitDebug(DebugLevelError, DebugStackLow);
+    }
+}
+
+void Network::queryStackUsage(long alarmThreshold) {
+    stackAlarmThreshold = alarmThreshold;
+    stackAlarmRaised = false;
+
+    const long free = io->StackFreeMinimum(0);
+    if (notificationHandler) {
+        notificationHandler->stackUsageReported(free);
+    }
 }
 
 void Network::connect(MicroFlo::NodeId srcId, MicroFlo::PortId srcPort,
                       MicroFlo::NodeId targetId,MicroFlo::PortId targetPort) {
     if (!MICROFLO_VALID_NODEID(srcId) || !MICROFLO_VALID_NODEID(targetId)) {
-        MICROFLO_DEBUG(this, DebugLevelError, DebugNetworkConnectInvalidNodes);
+        MICROFLO_NETWORK_DEBUG(DebugLevelError, DebugNetworkConnectInvalidNodes);
         return;
     }
 
     connect(nodes[srcId], srcPort, nodes[targetId], targetPort);
 }
 
+void Network::disconnect(MicroFlo::NodeId srcId, MicroFlo::PortId srcPort) {
+    if (!MICROFLO_VALID_NODEID(srcId)) {
+        MICROFLO_NETWORK_DEBUG(DebugLevelError, DebugNetworkConnectInvalidNodes);
+        return;
+    }
+
+    Component *src = nodes[srcId];
+    if (srcPort < 0 || srcPort >= src->nPorts) {
+        MICROFLO_NETWORK_DEBUG(DebugLevelError, DebugComponentSendInvalidPort);
+        return;
+    }
+    src->connect(srcPort, 0, -1);
+    if (notificationHandler) {
+        notificationHandler->nodesDisconnected(src, srcPort);
+    }
+}
+
 void Network::connect(Component *src, MicroFlo::PortId srcPort,
                       Component *target, MicroFlo::PortId targetPort) {
     src->connect(srcPort, target, targetPort);
@@ -417,15 +1193,26 @@ void Network::connect(Component *src, MicroFlo::PortId srcPort,
 
 MicroFlo::NodeId Network::addNode(Component *node, MicroFlo::NodeId parentId) {
     if (!node) {
-        MICROFLO_DEBUG(this, DebugLevelError, DebugAddNodeInvalidInstance);
+        MICROFLO_NETWORK_DEBUG(DebugLevelError, DebugAddNodeInvalidInstance);
+        return 0;
+    }
+    if (parentId > 0 && !MICROFLO_VALID_NODEID(parentId)) {
+        MICROFLO_NETWORK_DEBUG(DebugLevelError, DebugAddNodeInvalidParent);
+        delete node;
         return 0;
     }
-    if (parentId > lastAddedNodeIndex) {
-        MICROFLO_DEBUG(this, DebugLevelError, DebugAddNodeInvalidParent);
+
+    MicroFlo::NodeId nodeId = 0;
+    if (freeNodeCount > 0) {
+        nodeId = freeNodes[--freeNodeCount];
+    } else if (lastAddedNodeIndex < MICROFLO_MAX_NODES) {
+        nodeId = lastAddedNodeIndex++;
+    } else {
+        MICROFLO_NETWORK_DEBUG(DebugLevelError, DebugAddNodeNoFreeId);
+        delete node;
         return 0;
     }
 
-    const int nodeId = lastAddedNodeIndex;
     nodes[nodeId] = node;
     node->setNetwork(this, nodeId, this->io);
     if (parentId > 0) {
@@ -434,10 +1221,70 @@ MicroFlo::NodeId Network::addNode(Component *node, MicroFlo::NodeId parentId) {
     if (notificationHandler) {
         notificationHandler->nodeAdded(node, parentId);
     }
-    lastAddedNodeIndex++;
+    if (state == Running) {
+        // Added to a live network, missed runSetup()
+        node->process(Packet(MsgSetup), -1);
+    }
     return nodeId;
 }
 
+// Removes node, and its children if a subgraph. Connections to it are disconnected,
+// and queued messages to it are discarded when their turn comes
+void Network::removeNode(MicroFlo::NodeId nodeId) {
+    if (!MICROFLO_VALID_NODEID(nodeId)) {
+        MICROFLO_NETWORK_DEBUG(DebugLevelError, DebugRemoveNodeInvalidNode);
+        return;
+    }
+    Component *node = nodes[nodeId];
+
+    for (int i=Network::firstNodeId; i<lastAddedNodeIndex; i++) {
+        if (nodes[i] && nodes[i]->parentNodeId == nodeId) {
+            removeNode(i);
+        }
+    }
+
+    for (int i=Network::firstNodeId; i<lastAddedNodeIndex; i++) {
+        Component *c = nodes[i];
+        if (!c || c == node) {
+            continue;
+        }
+        for (int p=0; p<c->nPorts; p++) {
+            if (c->connections[p].target == node) {
+                disconnect(i, p);
+            }
+        }
+        if (c->componentId == IdSubGraph) {
+            Components::SubGraph *subgraph = (Components::SubGraph *)c;
+            for (int p=0; p<MICROFLO_SUBGRAPH_MAXPORTS; p++) {
+                if (subgraph->inputConnections[p].target == node) {
+                    subgraph->inputConnections[p].target = 0;
+                }
+                if (subgraph->outputConnections[p].target == node) {
+                    subgraph->outputConnections[p].target = 0;
+                }
+            }
+        }
+    }
+
+    for (int i=0; i<MICROFLO_MAX_MESSAGES; i++) {
+        if (messages[i].target == node) {
+            messages[i].target = 0;
+        }
+    }
+    for (int i=0; i<MICROFLO_MAX_SUBSCRIPTIONS; i++) {
+        if (subscriptions[i].node == node) {
+            subscriptions[i].node = 0;
+        }
+    }
+
+    if (notificationHandler) {
+        notificationHandler->nodeRemoved(node);
+    }
+    nodes[nodeId] = 0;
+    delete node;
+    freeNodes[freeNodeCount++] = nodeId;
+}
+
 void Network::reset() {
     state = Stopped;
     if (notificationHandler) {
@@ -450,9 +1297,15 @@ void Network::reset() {
             nodes[i] = 0;
         }
     }
+    for (int i=0; i<MICROFLO_MAX_SUBSCRIPTIONS; i++) {
+        subscriptions[i].node = 0;
+    }
     lastAddedNodeIndex = Network::firstNodeId;
+    freeNodeCount = 0;
     messageWriteIndex = 0;
     messageReadIndex = 0;
+    wideWriteIndex = 0;
+    wideQueued = 0;
 }
 
 void Network::start() {
@@ -473,15 +1326,17 @@ void Network::emitDebug(DebugLevel level, DebugId id) {
 }
 
 void Network::setDebugLevel(DebugLevel level) {
-    debugLevel = level;
+    // Host is told what it actually gets
+    debugLevel = (level > MICROFLO_DEBUG_LEVEL_MAX) ? (DebugLevel)MICROFLO_DEBUG_LEVEL_MAX : level;
     if (notificationHandler) {
         notificationHandler->debugChanged(debugLevel);
     }
 }
 
-void Network::subscribeToPort(MicroFlo::NodeId nodeId, MicroFlo::PortId portId, bool enable) {
+void Network::subscribeToPort(MicroFlo::NodeId nodeId, MicroFlo::PortId portId, bool enable,
+                              SubscriptionMode mode, uint16_t period) {
     if (!MICROFLO_VALID_NODEID(nodeId)) {
-        MICROFLO_DEBUG(this, DebugLevelError, DebugSubscribePortInvalidNode);
+        MICROFLO_NETWORK_DEBUG(DebugLevelError, DebugSubscribePortInvalidNode);
         return;
     }
 
@@ -490,10 +1345,92 @@ void Network::subscribeToPort(MicroFlo::NodeId nodeId, MicroFlo::PortId portId,
         return;
     }
 
+    int subscription = -1;
+    for (int i=0; i<MICROFLO_MAX_SUBSCRIPTIONS; i++) {
+        if (subscriptions[i].node == c && subscriptions[i].port == portId) {
+            subscriptions[i].node = 0;
+        }
+    }
+    if (enable && mode != SubscriptionModeAll) {
+        for (int i=0; i<MICROFLO_MAX_SUBSCRIPTIONS; i++) {
+            if (!subscriptions[i].node) {
+                subscription = i;
+                break;
+            }
+        }
+        if (subscription < 0) {
+            MICROFLO_NETWORK_DEBUG(DebugLevelError, DebugSubscriptionTableFull);
+            enable = false;
+        } else {
+            PortSubscription &s = subscriptions[subscription];
+            s.node = c;
+            s.port = portId;
+            s.mode = mode;
+            s.period = period ? period : 1;
+            s.count = 0;
+            s.sum = 0;
+            // RateLimit lets first packet through
+            s.lastMs = io->TimerCurrentMs() - (mode == SubscriptionModeRateLimit ? s.period : 0);
+        }
+    }
+
     c->connections[portId].subscribed = enable;
 
     if (notificationHandler) {
-        notificationHandler->portSubscriptionChanged(nodeId, portId, enable);
+        notificationHandler->portSubscriptionChanged(nodeId, portId, enable, mode, subscription);
+    }
+}
+
+// Decides if a packet on subscribed port should be notified, and accumulates summaries
+bool Network::subscriptionAccepts(Component *sender, MicroFlo::PortId senderPort, const Packet &pkg) {
+    for (int i=0; i<MICROFLO_MAX_SUBSCRIPTIONS; i++) {
+        PortSubscription &s = subscriptions[i];
+        if (s.node != sender || s.port != senderPort) {
+            continue;
+        }
+
+        if (s.mode == SubscriptionModeEveryNth) {
+            if (++s.count >= s.period) {
+                s.count = 0;
+                return true;
+            }
+        } else if (s.mode == SubscriptionModeRateLimit) {
+            const long now = io->TimerCurrentMs();
+            if (now - s.lastMs >= s.period) {
+                s.lastMs = now;
+                return true;
+            }
+        } else if (s.mode == SubscriptionModeSummary) {
+            if (pkg.isNumber() || pkg.isByte()) {
+                const long value = pkg.asInteger();
+                if (s.count == 0 || value < s.minimum) {
+                    s.minimum = value;
+                }
+                if (s.count == 0 || value > s.maximum) {
+                    s.maximum = value;
+                }
+                s.sum += value;
+                s.count++;
+            }
+        }
+        return false;
+    }
+    return true;
+}
+
+void Network::reportSubscriptions() {
+    const long now = io->TimerCurrentMs();
+    for (int i=0; i<MICROFLO_MAX_SUBSCRIPTIONS; i++) {
+        PortSubscription &s = subscriptions[i];
+        if (!s.node || s.mode != SubscriptionModeSummary || now - s.lastMs < s.period) {
+            continue;
+        }
+        if (s.count > 0 && notificationHandler) {
+            notificationHandler->portSummaryReported(i, s.minimum, s.maximum, s.sum/s.count);
+        }
+        s.count = 0;
+        s.sum = 0;
+        s.lastMs = now;
     }
 }
 
@@ -502,14 +1439,14 @@ void Network::connectSubgraph(bool isOutput,
                               MicroFlo::NodeId childNode, MicroFlo::PortId childPort) {
 
     if (!MICROFLO_VALID_NODEID(subgraphNode) || !MICROFLO_VALID_NODEID(childNode)) {
-        MICROFLO_DEBUG(this, DebugLevelError, DebugSubGraphConnectInvalidNodes);
+        MICROFLO_NETWORK_DEBUG(DebugLevelError, DebugSubGraphConnectInvalidNodes);
         return;
     }
 
     Component *comp = nodes[subgraphNode];
     Component *child = nodes[childNode];
     if (comp->component() != IdSubGraph || child->parentNodeId < Network::firstNodeId) {
-        MICROFLO_DEBUG(this, DebugLevelError, DebugSubGraphConnectNotASubgraph);
+        MICROFLO_NETWORK_DEBUG(DebugLevelError, DebugSubGraphConnectNotASubgraph);
         return;
     }
 
@@ -525,21 +1462,43 @@ void Network::connectSubgraph(bool isOutput,
 }
 
 void HostCommunication::nodeAdded(Component *c, MicroFlo::NodeId parentId) {
-    transport->sendCommandByte(GraphCmdNodeAdded);
-    transport->sendCommandByte(c->component());
-    transport->sendCommandByte(c->id());
-    transport->sendCommandByte(parentId);
-    transport->padCommandWithNArguments(3);
+    sendCommandByte(GraphCmdNodeAdded);
+    sendCommandByte(c->component());
+    sendCommandByte(c->id());
+    sendCommandByte(parentId);
+    finishCommand();
+}
+
+void HostCommunication::nodeRemoved(Component *c) {
+    releaseTelemetryChannels(c, -1);
+    for (int i=0; i<MICROFLO_STREAMS; i++) {
+        if (streams[i].node == c) {
+            streams[i].node = 0;
+        }
+    }
+    sendCommandByte(GraphCmdNodeRemoved);
+    sendCommandByte(c->id());
+    finishCommand();
 }
 
 void HostCommunication::nodesConnected(Component *src, MicroFlo::PortId srcPort,
                                        Component *target, MicroFlo::PortId targetPort) {
-    transport->sendCommandByte(GraphCmdNodesConnected);
-    transport->sendCommandByte(src->id());
-    transport->sendCommandByte(srcPort);
-    transport->sendCommandByte(target->id());
-    transport->sendCommandByte(targetPort);
-    transport->padCommandWithNArguments(4);
+    // Channel announcement names the old target
+    releaseTelemetryChannels(src, srcPort);
+    sendCommandByte(GraphCmdNodesConnected);
+    sendCommandByte(src->id());
+    sendCommandByte(srcPort);
+    sendCommandByte(target->id());
+    sendCommandByte(targetPort);
+    finishCommand();
+}
+
+void HostCommunication::nodesDisconnected(Component *src, MicroFlo::PortId srcPort) {
+    releaseTelemetryChannels(src, srcPort);
+    sendCommandByte(GraphCmdNodesDisconnected);
+    sendCommandByte(src->id());
+    sendCommandByte(srcPort);
+    finishCommand();
 }
 
 void HostCommunication::networkStateChanged(Network::State s) {
@@ -549,8 +1508,8 @@ void HostCommunication::networkStateChanged(Network::State s) {
     } else if (s == Network::Stopped) {
         cmd = GraphCmdNetworkStopped;
     }
-    transport->sendCommandByte(cmd);
-    transport->padCommandWithNArguments(0);
+    sendCommandByte(cmd);
+    finishCommand();
 }
 
 void HostCommunication::packetSent(int index, Message m, Component *src, MicroFlo::PortId srcPort) {
@@ -558,73 +1517,343 @@ void HostCommunication::packetSent(int index, Message m, Component *src, MicroFl
         return;
     }
 
-    transport->sendCommandByte(GraphCmdPacketSent);
-    transport->sendCommandByte(src->id());
-    transport->sendCommandByte(srcPort);
-    transport->sendCommandByte(m.target->id());
-    transport->sendCommandByte(m.targetPort);
-    transport->sendCommandByte(m.pkg.type());
+    if (telemetryEncoding == TelemetryEncodingDelta) {
+        // Record: (channel<<4 | type), payload. Several records are packed in one TelemetryData.
+        // Integers are zigzag varint deltas (type 0xF) against previous value on channel,
+        // with full 32 bit keyframes every keyframeInterval samples
+        const int ch = telemetryChannel(src, srcPort, m.target, m.targetPort);
+        uint8_t record[5];
+        uint8_t length = 1;
+        uint8_t type = m.pkg.type();
+        if (m.pkg.isInteger()) {
+            TelemetryChannel &c = channels[ch];
+            const int32_t value = m.pkg.asInteger();
+            const uint32_t delta = (uint32_t)value - (uint32_t)c.last;
+            uint32_t zigzag = (delta << 1) ^ (uint32_t)((int32_t)delta >> 31);
+            if (c.sinceKeyframe > 0 && c.sinceKeyframe < keyframeInterval && zigzag < (1UL<<21)) {
+                type = 0xF;
+                do {
+                    record[length++] = (zigzag & 0x7F) | (zigzag > 0x7F ? 0x80 : 0x00);
+                    zigzag >>= 7;
+                } while (zigzag);
+                c.sinceKeyframe++;
+            } else {
+                for (int i=0; i<4; i++) {
+                    record[length++] = (uint32_t)value >> (8*i);
+                }
+                c.sinceKeyframe = 1;
+            }
+            c.last = value;
+        } else if (m.pkg.isFloat()) {
+            const float f = m.pkg.asFloat();
+            memcpy(record+length, &f, 4);
+            length += 4;
+        } else if (m.pkg.isBool() || m.pkg.isByte() || m.pkg.isAscii()) {
+            record[length++] = m.pkg.asByte();
+        }
+        record[0] = (ch << 4) | type;
+
+        if (telemetryLength + length > MICROFLO_CMD_SIZE-1) {
+            flushTelemetry();
+        }
+        memcpy(telemetryBuffer+telemetryLength, record, length);
+        telemetryLength += length;
+        return;
+    }
+
+    sendCommandByte(GraphCmdPacketSent);
+    sendCommandByte(src->id());
+    sendCommandByte(srcPort);
+    sendCommandByte(m.target->id());
+    sendCommandByte(m.targetPort);
+    sendCommandByte(m.pkg.type());
 
     if (m.pkg.isData()) {
         if (m.pkg.isBool()) {
-            transport->sendCommandByte(m.pkg.asBool());
-            transport->padCommandWithNArguments(6);
+            sendCommandByte(m.pkg.asBool());
+            finishCommand(true);
         } else if (m.pkg.isVoid()) {
-            transport->padCommandWithNArguments(5);
+            finishCommand(true);
         } else if (m.pkg.isNumber()){
             // FIXME: truncates
             const int i = m.pkg.asInteger();
-            transport->sendCommandByte(i>>0);
-            transport->sendCommandByte(i>>8);
-            transport->padCommandWithNArguments(8);
+            sendCommandByte(i>>0);
+            sendCommandByte(i>>8);
+            finishCommand(true);
         } else {
             // FIXME: support all types
-            transport->padCommandWithNArguments(5); // finish command before sending debug
+            finishCommand(true); // finish command before sending debug
             MICROFLO_DEBUG(network, DebugLevelError, DebugNotImplemented);
         }
     } else {
-        transport->padCommandWithNArguments(5);
+        finishCommand(true);
     }
 }
 
-// FIXME: implement
-void HostCommunication::packetDelivered(int index, Message m) {
-    /*Serial.print(index);
-    Serial.print(m.target->nodeId);
-    printPacket(&m.pkg);*/
+// Credit for delivered stream packets goes back to host in batches of half a window,
+// or all of it once nothing is outstanding. Packets from edges and IIPs to the same port do not count
+void HostCommunication::packetDelivered(int index, Message m, bool fromStream) {
+    if (!fromStream) {
+        return;
+    }
+    for (int i=0; i<MICROFLO_STREAMS; i++) {
+        InputStream &s = streams[i];
+        if (s.node != m.target || s.port != m.targetPort || s.outstanding == 0) {
+            continue;
+        }
+        s.outstanding--;
+        if (++s.consumed >= (s.window+1)/2 || s.outstanding == 0) {
+            sendCommandByte(GraphCmdStreamCredit);
+            sendCommandByte(i);
+            sendCommandByte(s.consumed);
+            finishCommand();
+            s.consumed = 0;
+        }
+        return;
+    }
 }
 
+// Only recorded here, so that debugging does not slow down what is being debugged much.
+// Repeats of a queued message just increase its count. When queue is full, new messages are dropped
 void HostCommunication::emitDebug(DebugLevel level, DebugId id) {
-    transport->sendCommandByte(GraphCmdDebugMessage);
-    transport->sendCommandByte(level);
-    transport->sendCommandByte(id);
-    transport->padCommandWithNArguments(2);
+    for (uint8_t i=0; i<debugQueued; i++) {
+        DebugEvent &e = debugEvents[(debugFirst+i) % MICROFLO_DEBUG_BUFFER_SIZE];
+        if (e.level == level && e.id == id) {
+            if (e.count < 0xFFFF) {
+                e.count++;
+            }
+            return;
+        }
+    }
+    if (debugQueued == MICROFLO_DEBUG_BUFFER_SIZE) {
+        if (debugDropped < 0xFFFF) {
+            debugDropped++;
+        }
+        return;
+    }
+    DebugEvent &e = debugEvents[(debugFirst+debugQueued) % MICROFLO_DEBUG_BUFFER_SIZE];
+    e.level = level;
+    e.id = id;
+    e.count = 1;
+    e.time = (network && network->io) ? network->io->TimerCurrentMs() : 0;
+    debugQueued++;
+}
+
+// DebugMessage is [level, id, count (16 bit), time of first in ms (24 bit)]
+void HostCommunication::flushDebug() {
+    while (debugQueued > 0 || debugDropped > 0) {
+        if (!transport->canSend(commandWireBytes(MICROFLO_CMD_SIZE))) {
+            // Stays queued until transport has room, not counted as dropped
+            return;
+        }
+        DebugEvent e;
+        if (debugQueued > 0) {
+            e = debugEvents[debugFirst];
+        } else {
+            e.level = DebugLevelError;
+            e.id = DebugMessagesDropped;
+            e.count = debugDropped;
+            e.time = (network && network->io) ? network->io->TimerCurrentMs() : 0;
+        }
+        sendCommandByte(GraphCmdDebugMessage);
+        sendCommandByte(e.level);
+        sendCommandByte(e.id);
+        sendCommandByte(e.count>>0);
+        sendCommandByte(e.count>>8);
+        sendCommandByte(e.time>>0);
+        sendCommandByte(e.time>>8);
+        sendCommandByte(e.time>>16);
+        if (!finishCommand(true)) {
+            return;
+        }
+        if (debugQueued > 0) {
+            debugFirst = (debugFirst+1) % MICROFLO_DEBUG_BUFFER_SIZE;
+            debugQueued--;
+        } else {
+            debugDropped = 0;
+        }
+    }
 }
 
 void HostCommunication::debugChanged(DebugLevel level) {
-    transport->sendCommandByte(GraphCmdDebugChanged);
-    transport->sendCommandByte(level);
-    transport->padCommandWithNArguments(1);
+    sendCommandByte(GraphCmdDebugChanged);
+    sendCommandByte(level);
+    finishCommand();
+}
+
+void HostCommunication::portSubscriptionChanged(MicroFlo::NodeId nodeId, MicroFlo::PortId portId, bool enable,
+                                                SubscriptionMode mode, int subscription) {
+    for (int i=0; i<MICROFLO_TELEMETRY_CHANNELS; i++) {
+        if (!enable && channels[i].node && channels[i].node->id() == nodeId && channels[i].port == portId) {
+            channels[i].node = 0;
+        }
+    }
+
+    sendCommandByte(GraphCmdPortSubscriptionChanged);
+    sendCommandByte(nodeId);
+    sendCommandByte(portId);
+    sendCommandByte(enable);
+    sendCommandByte(mode);
+    sendCommandByte(subscription);
+    finishCommand();
+}
+
+// Values are saturated to 16 bit
+static int16_t saturate16(long v) {
+    return (v > 32767) ? 32767 : ((v < -32768) ? -32768 : v);
+}
+
+void HostCommunication::portSummaryReported(int subscription, long minimum, long maximum, long mean) {
+    const int16_t values[3] = { saturate16(minimum), saturate16(maximum), saturate16(mean) };
+    sendCommandByte(GraphCmdPortSummary);
+    sendCommandByte(subscription);
+    for (int i=0; i<3; i++) {
+        sendCommandByte(values[i]>>0);
+        sendCommandByte(values[i]>>8);
+    }
+    finishCommand(true);
 }
 
-void HostCommunication::portSubscriptionChanged(MicroFlo::NodeId nodeId, MicroFlo::PortId portId, bool enable) {
-    transport->sendCommandByte(GraphCmdPortSubscriptionChanged);
-    transport->sendCommandByte(nodeId);
-    transport->sendCommandByte(portId);
-    transport->sendCommandByte(enable);
-    transport->padCommandWithNArguments(3);
+void HostCommunication::stackUsageReported(long minimumFree) {
+    sendCommandByte(GraphCmdStackUsage);
+    sendCommandByte(minimumFree>>0);
+    sendCommandByte(minimumFree>>8);
+    sendCommandByte(minimumFree>>16);
+    sendCommandByte(minimumFree>>24);
+    finishCommand();
 }
 
 void HostCommunication::subgraphConnected(bool isOutput,
                                       MicroFlo::NodeId subgraphNode, MicroFlo::PortId subgraphPort,
                                       MicroFlo::NodeId childNode, MicroFlo::PortId childPort) {
-    transport->sendCommandByte(GraphCmdSubgraphPortConnected);
-    transport->sendCommandByte(isOutput);
-    transport->sendCommandByte(subgraphNode);
-    transport->sendCommandByte(subgraphPort);
-    transport->sendCommandByte(childNode);
-    transport->sendCommandByte(childPort);
-    transport->padCommandWithNArguments(5);
+    sendCommandByte(GraphCmdSubgraphPortConnected);
+    sendCommandByte(isOutput);
+    sendCommandByte(subgraphNode);
+    sendCommandByte(subgraphPort);
+    sendCommandByte(childNode);
+    sendCommandByte(childPort);
+    finishCommand();
+}
+
+void HostCommunication::sendCommandByte(uint8_t b) {
+    if (outLength == 0 && telemetryLength > 0) {
+        // Keep order of telemetry relative to other commands
+        flushTelemetry();
+    }
+    if (outLength < MICROFLO_CMD_SIZE) {
+        outBuffer[outLength++] = b;
+    }
+}
+
+void HostCommunication::telemetryDropped(uint16_t commands) {
+    sendCommandByte(GraphCmdTelemetryDropped);
+    sendCommandByte(commands>>0);
+    sendCommandByte(commands>>8);
+    finishCommand();
+}
+
+void HostCommunication::flushTelemetry() {
+    if (telemetryLength == 0) {
+        return;
+    }
+    outBuffer[0] = GraphCmdTelemetryData;
+    memcpy(outBuffer+1, telemetryBuffer, telemetryLength);
+    outLength = telemetryLength+1;
+    telemetryLength = 0;
+    if (!finishCommand(true)) {
+        // Host missed values deltas are based on
+        for (int i=0; i<MICROFLO_TELEMETRY_CHANNELS; i++) {
+            channels[i].sinceKeyframe = 0;
+        }
+    }
+}
+
+// Frees channels of @port on @node, or of all its ports if @port is -1
+void HostCommunication::releaseTelemetryChannels(Component *node, MicroFlo::PortId port) {
+    for (int i=0; i<MICROFLO_TELEMETRY_CHANNELS; i++) {
+        if (node && channels[i].node == node && (port < 0 || channels[i].port == port)) {
+            channels[i].node = 0;
+        }
+    }
+}
+
+void HostCommunication::resetTelemetry() {
+    for (int i=0; i<MICROFLO_TELEMETRY_CHANNELS; i++) {
+        channels[i].node = 0;
+    }
+}
+
+// Returns channel for port, allocating and announcing it to host if needed
+int HostCommunication::telemetryChannel(Component *src, MicroFlo::PortId srcPort,
+                                        Component *target, MicroFlo::PortId targetPort) {
+    int ch = -1;
+    for (int i=0; i<MICROFLO_TELEMETRY_CHANNELS; i++) {
+        if (channels[i].node == src && channels[i].port == srcPort) {
+            return i;
+        } else if (ch < 0 && !channels[i].node) {
+            ch = i;
+        }
+    }
+    if (ch < 0) {
+        ch = nextEvicted;
+        nextEvicted = (nextEvicted+1) % MICROFLO_TELEMETRY_CHANNELS;
+    }
+    channels[ch].node = src;
+    channels[ch].port = srcPort;
+    channels[ch].last = 0;
+    channels[ch].sinceKeyframe = 0;
+
+    sendCommandByte(GraphCmdTelemetryChannel);
+    sendCommandByte(ch);
+    sendCommandByte(src->id());
+    sendCommandByte(srcPort);
+    sendCommandByte(target->id());
+    sendCommandByte(targetPort);
+    finishCommand();
+    return ch;
+}
+
+// Size on the wire of a command with @length bytes.
+// Compact framing adds at most COBS code byte and delimiter
+int HostCommunication::commandWireBytes(int length) {
+    return (framing == FramingCompact) ? length+2 : MICROFLO_CMD_SIZE;
+}
+
+// Returns false if transport dropped the command
+bool HostCommunication::finishCommand(bool droppable) {
+    if (!transport->beginCommand(commandWireBytes(outLength), droppable)) {
+        outLength = 0;
+        return false;
+    }
+
+    if (framing == FramingCompact) {
+        // Trailing zeros are implied by the receiver
+        int length = outLength;
+        while (length > 1 && outBuffer[length-1] == 0x00) {
+            length--;
+        }
+        // COBS: each block is prefixed by the distance to the next zero
+        int start = 0;
+        while (start <= length) {
+            int end = start;
+            while (end < length && outBuffer[end] != 0x00) {
+                end++;
+            }
+            transport->sendCommandByte(end-start+1);
+            for (int i=start; i<end; i++) {
+                transport->sendCommandByte(outBuffer[i]);
+            }
+            start = end+1;
+        }
+        transport->sendCommandByte(0x00);
+    } else {
+        for (int i=0; i<outLength; i++) {
+            transport->sendCommandByte(outBuffer[i]);
+        }
+        transport->padCommandWithNArguments(outLength-1);
+    }
+    outLength = 0;
+    return true;
 }
 
 void HostTransport::padCommandWithNArguments(int arguments) {
@@ -637,6 +1866,9 @@ void HostTransport::padCommandWithNArguments(int arguments) {
 SerialHostTransport::SerialHostTransport(uint8_t port, int baudRate)
     : serialPort(port)
     , serialBaudrate(baudRate)
+    , txRead(0)
+    , txQueued(0)
+    , txDropped(0)
 {
 
 }
@@ -650,14 +1882,91 @@ void SerialHostTransport::setup(IO *i, HostCommunication *c) {
 
 
 void SerialHostTransport::runTick() {
-    if (io->SerialDataAvailable(serialPort) > 0) {
-        unsigned char c = io->SerialRead(serialPort);
-        controller->parseByte(c);
+    controller->flushTelemetry();
+
+    // Read everything available, up to budget, so an upload does not take a tick per byte
+    uint8_t chunk[MICROFLO_CMD_SIZE*2];
+    int budget = MICROFLO_HOST_RX_BUDGET;
+    long available = io->SerialDataAvailable(serialPort);
+    while (available > 0 && budget > 0) {
+        int n = 0;
+        while (n < (int)sizeof(chunk) && n < budget && n < available) {
+            chunk[n++] = io->SerialRead(serialPort);
+        }
+        controller->parseBytes(chunk, n);
+        budget -= n;
+        available -= n;
+        if (available <= 0) {
+            available = io->SerialDataAvailable(serialPort);
+        }
+    }
+
+    controller->flushDebug();
+    writeQueued(false);
+    if (txDropped > 0 && txQueued == 0) {
+        const uint16_t dropped = txDropped;
+        txDropped = 0;
+        controller->telemetryDropped(dropped);
+    }
+}
+
+// Writes as much as IO can take without blocking, or everything if @blocking
+// or the IO cannot tell
+void SerialHostTransport::writeQueued(bool blocking) {
+    long room = io->SerialWriteAvailable(serialPort);
+    if (room < 0) {
+        room = txQueued;
+    }
+    while (txQueued > 0) {
+        if (room == 0) {
+            room = io->SerialWriteAvailable(serialPort);
+            if (room <= 0 && !blocking) {
+                break;
+            }
+            if (room <= 0) {
+                // Waiting, so a command is not cut short. If host has not made room by then,
+                // written anyway: IO which cannot wait for room reports the bytes it drops
+                io->SerialWaitWriteAvailable(serialPort, MICROFLO_HOST_TX_WAIT_MS);
+                room = io->SerialWriteAvailable(serialPort);
+                if (room <= 0) {
+                    room = txQueued;
+                }
+            }
+        }
+        io->SerialWrite(serialPort, txBuffer[txRead]);
+        txRead = (txRead+1) % MICROFLO_HOST_TX_BUFFER_SIZE;
+        txQueued--;
+        room--;
+    }
+}
+
+// Telemetry is dropped when buffer is full, so it never stalls the network.
+// Other commands wait for room, as host depends on them
+bool SerialHostTransport::beginCommand(int bytes, bool droppable) {
+    if (canSend(bytes)) {
+        return true;
     }
+    if (droppable) {
+        if (txDropped < 0xFFFF) {
+            txDropped++;
+        }
+        return false;
+    }
+    writeQueued(true);
+    return true;
+}
+
+bool SerialHostTransport::canSend(int bytes) {
+    return MICROFLO_HOST_TX_BUFFER_SIZE-txQueued >= bytes;
 }
 
 void SerialHostTransport::sendCommandByte(uint8_t b) {
-    io->SerialWrite(serialPort, b);
+    if (txQueued == MICROFLO_HOST_TX_BUFFER_SIZE) {
+        // Not reserved with beginCommand()
+        writeQueued(true);
+    }
+    txBuffer[(txRead+txQueued) % MICROFLO_HOST_TX_BUFFER_SIZE] = b;
+    txQueued++;
 }
 
 
@@ -31,13 +31,103 @@ const int MICROFLO_MAX_MESSAGES = MICROFLO_MESSAGE_LIMIT;
 const int MICROFLO_MAX_MESSAGES = 50;
 #endif
 
+// Integer and Float packets need a slot in a separate pool while queued,
+// other packet types are stored inline in the message queue. Max 256.
+// On AVR8 only a part of the queue can hold them by default, to save SRAM
+#ifdef MICROFLO_WIDE_MESSAGE_LIMIT
+const int MICROFLO_MAX_WIDE_MESSAGES = MICROFLO_WIDE_MESSAGE_LIMIT;
+#elif defined(AVR)
+const int MICROFLO_MAX_WIDE_MESSAGES = MICROFLO_MAX_MESSAGES/2;
+#else
+const int MICROFLO_MAX_WIDE_MESSAGES = MICROFLO_MAX_MESSAGES;
+#endif
+
+// Port subscriptions other than SubscriptionModeAll keep their state in a table
+#ifdef MICROFLO_SUBSCRIPTION_LIMIT
+const int MICROFLO_MAX_SUBSCRIPTIONS = MICROFLO_SUBSCRIPTION_LIMIT;
+#else
+const int MICROFLO_MAX_SUBSCRIPTIONS = 4;
+#endif
+
+// Ports with TelemetryEncodingDelta state. At most 16, channel is sent in 4 bits
+#ifdef MICROFLO_TELEMETRY_CHANNEL_LIMIT
+const int MICROFLO_TELEMETRY_CHANNELS = MICROFLO_TELEMETRY_CHANNEL_LIMIT;
+#else
+const int MICROFLO_TELEMETRY_CHANNELS = 4;
+#endif
+
+// Notifications to host are queued in SerialHostTransport and written between ticks
+#ifdef MICROFLO_HOST_TX_BUFFER_LIMIT
+const int MICROFLO_HOST_TX_BUFFER_SIZE = MICROFLO_HOST_TX_BUFFER_LIMIT;
+#else
+const int MICROFLO_HOST_TX_BUFFER_SIZE = 64;
+#endif
+
+// How long SerialHostTransport waits for room to write a notification which cannot be dropped
+#ifdef MICROFLO_HOST_TX_WAIT_LIMIT
+const int MICROFLO_HOST_TX_WAIT_MS = MICROFLO_HOST_TX_WAIT_LIMIT;
+#else
+const int MICROFLO_HOST_TX_WAIT_MS = 1000;
+#endif
+
+// Max bytes SerialHostTransport reads and parses per tick
+#ifdef MICROFLO_HOST_RX_BUDGET_LIMIT
+const int MICROFLO_HOST_RX_BUDGET = MICROFLO_HOST_RX_BUDGET_LIMIT;
+#else
+const int MICROFLO_HOST_RX_BUDGET = 64;
+#endif
+
+// Block upload keeps this many CRC checked blocks, so they can arrive out of order.
+// Window must be a power of two, max 8. Block size max 250
+#ifdef MICROFLO_UPLOAD_WINDOW_LIMIT
+const int MICROFLO_UPLOAD_WINDOW = MICROFLO_UPLOAD_WINDOW_LIMIT;
+#else
+const int MICROFLO_UPLOAD_WINDOW = 4;
+#endif
+
+#ifdef MICROFLO_UPLOAD_BLOCK_LIMIT
+const int MICROFLO_UPLOAD_BLOCK_SIZE = MICROFLO_UPLOAD_BLOCK_LIMIT;
+#else
+const int MICROFLO_UPLOAD_BLOCK_SIZE = 16;
+#endif
+
+// Streams of packets from host to a port, with credit based flow control, see openStream()
+#ifdef MICROFLO_STREAM_LIMIT
+const int MICROFLO_STREAMS = MICROFLO_STREAM_LIMIT;
+#else
+const int MICROFLO_STREAMS = 2;
+#endif
+
+// Debug messages are queued, repeats counted, and sent by host transport between ticks
+#ifdef MICROFLO_DEBUG_BUFFER_LIMIT
+const int MICROFLO_DEBUG_BUFFER_SIZE = MICROFLO_DEBUG_BUFFER_LIMIT;
+#else
+const int MICROFLO_DEBUG_BUFFER_SIZE = 4;
+#endif
+
+// Debug calls above this level compile to nothing, whatever level is set at runtime.
+// 0 removes all of them. Set per target in Makefile
+#ifdef MICROFLO_DEBUG_LEVEL_LIMIT
+const int MICROFLO_DEBUG_LEVEL_MAX = MICROFLO_DEBUG_LEVEL_LIMIT;
+#else
+const int MICROFLO_DEBUG_LEVEL_MAX = DebugLevelMax;
+#endif
+
 #define MICROFLO_DEBUG(handler, level, code) \
 do { \
-    if (handler) { \
+    if ((level) <= MICROFLO_DEBUG_LEVEL_MAX && handler) { \
         handler->emitDebug(level, code); \
     } \
 } while(0)
 
+// In Network members, which emit through Network::emitDebug() without checking a handler
+#define MICROFLO_NETWORK_DEBUG(level, code) \
+do { \
+    if ((level) <= MICROFLO_DEBUG_LEVEL_MAX) { \
+        emitDebug(level, code); \
+    } \
+} while(0)
+
 namespace MicroFlo {
     typedef uint8_t NodeId;
     typedef int8_t PortId;
@@ -85,6 +175,7 @@ public:
     bool isInteger() const { return msg == MsgInteger; } // TODO: make into a long or long long
     bool isFloat() const { return msg == MsgFloat; }
     bool isNumber() const { return isInteger() || isFloat(); }
+    bool isNarrow() const { return !isNumber(); } // payload fits in a byte
 
     bool asBool() const ;
     float asFloat() const ;
@@ -115,13 +206,40 @@ struct Message {
     Packet pkg;
 };
 
+// Compact representation of a Message, as stored in the Network queue
+struct QueuedMessage {
+    Component *target;
+    MicroFlo::PortId targetPort;
+    uint8_t type : 7;
+    uint8_t fromStream : 1; // sent by host on a stream, see HostCommunication::openStream()
+    uint8_t value; // narrow packets: the payload, else: index into wide values
+};
+
+union WideValue {
+    long lng;
+    float flt;
+};
+
 class NetworkNotificationHandler;
 class IO;
 
+struct PortSubscription {
+    Component *node; // 0 if unused
+    MicroFlo::PortId port;
+    SubscriptionMode mode;
+    uint16_t period; // packets or ms, depending on mode
+    uint16_t count;
+    long lastMs;
+    long minimum;
+    long maximum;
+    long sum;
+};
+
 class Network {
 #ifdef HOST_BUILD
     friend class JavaScriptNetwork;
 #endif
+    friend class HostCommunication; // for debug timestamps and stream targets
 
 public:
     static const MicroFlo::NodeId firstNodeId = 1; // 0=reserved: no-parent-node
@@ -136,7 +254,11 @@ public:
     void reset();
     void start();
 
+    // Nodes can be added and removed while running. Ids of removed nodes are reused,
+    // most recently freed first
     MicroFlo::NodeId addNode(Component *node, MicroFlo::NodeId parentId);
+    void removeNode(MicroFlo::NodeId nodeId);
+    // Replaces existing connection of @srcPort, if any
     void connect(Component *src, MicroFlo::PortId srcPort,
                  Component *target, MicroFlo::PortId targetPort);
     void connect(MicroFlo::NodeId srcId, MicroFlo::PortId srcPort,
@@ -144,12 +266,22 @@ public:
     void connectSubgraph(bool isOutput,
                          MicroFlo::NodeId subgraphNode, MicroFlo::PortId subgraphPort,
                          MicroFlo::NodeId childNode, MicroFlo::PortId childPort);
+    void disconnect(MicroFlo::NodeId srcId, MicroFlo::PortId srcPort);
 
     void sendMessage(Component *target, MicroFlo::PortId targetPort, const Packet &pkg,
-                     Component *sender=0, MicroFlo::PortId senderPort=-1);
-    void sendMessage(MicroFlo::NodeId targetId, MicroFlo::PortId targetPort, const Packet &pkg);
+                     Component *sender=0, MicroFlo::PortId senderPort=-1, bool fromStream=false);
+    void sendMessage(MicroFlo::NodeId targetId, MicroFlo::PortId targetPort, const Packet &pkg,
+                     bool fromStream=false);
+    // Node which packets to @targetPort of @target are delivered to, and its port.
+    // Differs for SubGraph inports. 0 if inport is not connected
+    Component *deliveryTarget(Component *target, MicroFlo::PortId *targetPort);
+
+    void subscribeToPort(MicroFlo::NodeId nodeId, MicroFlo::PortId portId, bool enable,
+                         SubscriptionMode mode=SubscriptionModeAll, uint16_t period=0);
 
-    void subscribeToPort(MicroFlo::NodeId nodeId, MicroFlo::PortId portId, bool enable);
+    // Report minimum free stack observed. If @alarmThreshold > 0, a DebugStackLow
+    // error is emitted (once) when free stack drops below that many bytes
+    void queryStackUsage(long alarmThreshold);
 
     void setNotificationHandler(NetworkNotificationHandler *handler);
 
@@ -161,18 +293,30 @@ public:
 private:
     void runSetup();
     void deliverMessages(int firstIndex, int lastIndex);
+    Message dequeueMessage(int index);
     void processMessages();
+    void checkStackUsage();
+    bool subscriptionAccepts(Component *sender, MicroFlo::PortId senderPort, const Packet &pkg);
+    void reportSubscriptions();
 
 private:
     Component *nodes[MICROFLO_MAX_NODES];
     MicroFlo::NodeId lastAddedNodeIndex;
-    Message messages[MICROFLO_MAX_MESSAGES];
+    MicroFlo::NodeId freeNodes[MICROFLO_MAX_NODES]; // stack of removed node ids
+    uint8_t freeNodeCount;
+    QueuedMessage messages[MICROFLO_MAX_MESSAGES];
     int messageWriteIndex;
     int messageReadIndex;
+    WideValue wideValues[MICROFLO_MAX_WIDE_MESSAGES];
+    int wideWriteIndex;
+    int wideQueued;
     NetworkNotificationHandler *notificationHandler;
     IO *io;
     State state;
     DebugLevel debugLevel;
+    long stackAlarmThreshold;
+    bool stackAlarmRaised;
+    PortSubscription subscriptions[MICROFLO_MAX_SUBSCRIPTIONS];
 };
 
 class DebugHandler {
@@ -184,17 +328,25 @@ public:
 class NetworkNotificationHandler : public DebugHandler {
 public:
     virtual void packetSent(int index, Message m, Component *sender, MicroFlo::PortId senderPort) = 0;
-    virtual void packetDelivered(int index, Message m) = 0;
+    // @fromStream if host sent the packet on a stream
+    virtual void packetDelivered(int index, Message m, bool fromStream) = 0;
 
     virtual void nodeAdded(Component *c, MicroFlo::NodeId parentId) = 0;
+    // Called before @c is deleted
+    virtual void nodeRemoved(Component *c) = 0;
     virtual void nodesConnected(Component *src, MicroFlo::PortId srcPort,
                                 Component *target, MicroFlo::PortId targetPort) = 0;
+    virtual void nodesDisconnected(Component *src, MicroFlo::PortId srcPort) = 0;
     virtual void networkStateChanged(Network::State s) = 0;
     virtual void subgraphConnected(bool isOutput,
                                    MicroFlo::NodeId subgraphNode, MicroFlo::PortId subgraphPort,
                                    MicroFlo::NodeId childNode, MicroFlo::PortId childPort) = 0;
 
-    virtual void portSubscriptionChanged(MicroFlo::NodeId nodeId, MicroFlo::PortId portId, bool enable) = 0;
+    // @subscription is index used by portSummaryReported(), or -1
+    virtual void portSubscriptionChanged(MicroFlo::NodeId nodeId, MicroFlo::PortId portId, bool enable,
+                                         SubscriptionMode mode, int subscription) = 0;
+    virtual void portSummaryReported(int subscription, long minimum, long maximum, long mean) = 0;
+    virtual void stackUsageReported(long minimumFree) = 0;
 };
 
 struct Connection {
@@ -215,6 +367,7 @@ class IO {
 protected:
     DebugHandler *debug;
 public:
+    IO() : debug(0) {}
     virtual ~IO() {}
 
     // Serial
@@ -222,6 +375,11 @@ public:
     virtual long SerialDataAvailable(int serialDevice) = 0;
     virtual unsigned char SerialRead(int serialDevice) = 0;
     virtual void SerialWrite(int serialDevice, unsigned char b) = 0;
+    // Bytes that can be written now without blocking, at least. -1 if unknown
+    virtual long SerialWriteAvailable(int serialDevice) { return -1; }
+    // Wait up to @timeoutMs for SerialWriteAvailable() to be non-zero.
+    // Not needed where SerialWrite() itself waits for room
+    virtual void SerialWaitWriteAvailable(int serialDevice, int timeoutMs) { ; }
 
     // Pin config
     enum PinMode {
@@ -238,6 +396,20 @@ public:
     // Digital
     virtual void DigitalWrite(MicroFlo::PinId pin, bool val) = 0;
     virtual bool DigitalRead(MicroFlo::PinId pin) = 0;
+    // Up to 32 pins at once, bit i of @values is @pins[i]. Targets that can
+    // change several pins in one operation do so, others one pin at a time
+    virtual void DigitalWriteMany(const MicroFlo::PinId *pins, uint8_t count, uint32_t values) {
+        for (uint8_t i=0; i<count; i++) {
+            DigitalWrite(pins[i], (values >> i) & 1);
+        }
+    }
+    virtual uint32_t DigitalReadMany(const MicroFlo::PinId *pins, uint8_t count) {
+        uint32_t values = 0;
+        for (uint8_t i=0; i<count; i++) {
+            values |= (uint32_t)DigitalRead(pins[i]) << i;
+        }
+        return values;
+    }
 
     // Analog
     // Values should be [0..1023], for now
@@ -265,6 +437,27 @@ public:
     // XXX: user responsible for mapping pin number to interrupt number
     virtual void AttachExternalInterrupt(int interrupt, IO::Interrupt::Mode mode,
                                          IOInterruptFunction func, void *user) = 0;
+    // When the interrupt being handled happened, on the TimerCurrentMicros() clock.
+    // Targets without timestamped interrupts give the current time
+    virtual long InterruptTimeMicros() { return TimerCurrentMicros(); }
+
+    // Stack
+    // Number of stack bytes never touched since startup (high-water mark), found by
+    // scanning memory painted at boot. Scanning stops after @limit bytes if @limit > 0.
+    // Returns -1 when the target does not paint its stack
+    virtual long StackFreeMinimum(long limit) { return -1; }
+
+    // Storage
+    // Non-volatile memory (EEPROM, flash or file) for keeping the uploaded graph over a
+    // power cycle. Used as two banks of StorageSize()/2, and StorageErase() is called on
+    // one bank at a time, leaving the other intact. Each bank starts with an 8 byte header.
+    // Writes are 8 bytes at 8-aligned offsets, and each offset is written at most once
+    // after its bank was erased, so flash can be programmed without erasing again.
+    // Targets without storage return 0 / false
+    virtual long StorageSize() { return 0; }
+    virtual bool StorageErase(long offset, long length) { return false; }
+    virtual bool StorageWrite(long offset, const uint8_t *data, uint8_t length) { return false; }
+    virtual bool StorageRead(long offset, uint8_t *data, uint8_t length) { return false; }
 };
 
 // Component
@@ -337,28 +530,103 @@ public:
     void setup(Network *net, HostTransport *t);
 
     void parseByte(char b);
+    void parseBytes(const uint8_t *data, size_t length);
 
     // Implements NetworkNotificationHandler
     virtual void packetSent(int index, Message m, Component *sender, MicroFlo::PortId senderPort);
-    virtual void packetDelivered(int index, Message m);
+    virtual void packetDelivered(int index, Message m, bool fromStream);
     virtual void nodeAdded(Component *c, MicroFlo::NodeId parentId);
+    virtual void nodeRemoved(Component *c);
     virtual void nodesConnected(Component *src, MicroFlo::PortId srcPort,
                                 Component *target, MicroFlo::PortId targetPort);
+    virtual void nodesDisconnected(Component *src, MicroFlo::PortId srcPort);
     virtual void networkStateChanged(Network::State s);
     virtual void emitDebug(DebugLevel level, DebugId id);
     virtual void debugChanged(DebugLevel level);
-    virtual void portSubscriptionChanged(MicroFlo::NodeId nodeId, MicroFlo::PortId portId, bool enable);
+    virtual void portSubscriptionChanged(MicroFlo::NodeId nodeId, MicroFlo::PortId portId, bool enable,
+                                         SubscriptionMode mode, int subscription);
+    virtual void portSummaryReported(int subscription, long minimum, long maximum, long mean);
+    virtual void stackUsageReported(long minimumFree);
     virtual void subgraphConnected(bool isOutput, MicroFlo::NodeId subgraphNode,
                                    MicroFlo::PortId subgraphPort, MicroFlo::NodeId childNode, MicroFlo::PortId childPort);
 
+    // Called by transport when telemetry had to be dropped
+    void telemetryDropped(uint16_t commands);
+    // Called by transport each tick, sends records that did not fill a command
+    void flushTelemetry();
+    // Called by transport when idle, sends queued debug messages
+    void flushDebug();
+
+    // Keep graphs uploaded from now on in @storage, each replacing the previous. 0 disables
+    void setStorage(IO *storage);
+    // Build the network from graph in storage. Returns false if there is none, or it is corrupt
+    bool loadStoredGraph();
+    // Build the network from a precompiled graph image. Returns false if @image is invalid
+    bool loadGraphImage(const uint8_t *image, size_t length);
+
 private:
     void parseCmd();
+    void parseCompactByte(uint8_t b);
+    void parseBatchByte(uint8_t b);
+    void parseUploadByte(uint8_t b);
+    void parseImageByte(uint8_t b);
+    void finishUploadBlock();
+
+    void sendCommandByte(uint8_t b);
+    bool finishCommand(bool droppable=false);
+    int commandWireBytes(int length);
+    int telemetryChannel(Component *src, MicroFlo::PortId srcPort, Component *target, MicroFlo::PortId targetPort);
+    void releaseTelemetryChannels(Component *node, MicroFlo::PortId port);
+    void resetTelemetry();
+    long storageBankSize();
+    int activeStorageBank(uint8_t *sequence, uint16_t *length);
+    void startStoredGraph();
+    void storeBytes(const uint8_t *data, uint8_t length);
+    void finishStoredGraph(bool valid);
+    void openStream(uint8_t stream, MicroFlo::NodeId nodeId, MicroFlo::PortId port, uint8_t window);
+    void streamData();
+    void resetStreams();
 private:
+    // Debug message waiting to be sent, with number of times it happened since first @time
+    struct DebugEvent {
+        uint8_t level;
+        uint8_t id;
+        uint16_t count;
+        long time;
+    };
+
+    // Host may have @window packets of a stream in flight. Credits for @consumed
+    // packets are returned when half of the window has been delivered
+    struct InputStream {
+        Component *node;
+        MicroFlo::PortId port;
+        uint8_t window;
+        uint8_t outstanding;
+        uint8_t consumed;
+    };
+
+    // Delta telemetry state of one subscribed port
+    struct TelemetryChannel {
+        Component *node;
+        MicroFlo::PortId port;
+        int32_t last;
+        uint8_t sinceKeyframe; // 0 means next integer is sent in full
+    };
+
     enum State {
         Invalid = -1,
         ParseHeader,
         ParseCmd,
-        LookForHeader
+        LookForHeader,
+        ParseCompactCmd,
+        ParseUpload
+    };
+    // Fixed: every command is MICROFLO_CMD_SIZE bytes, zero padded
+    // Compact: COBS encoded, trailing zeros trimmed, 0x00 delimited.
+    // Selected by the magic string the host sends, used in both directions
+    enum Framing {
+        FramingFixed,
+        FramingCompact
     };
 
     Network *network;
@@ -366,6 +634,50 @@ private:
     uint8_t currentByte;
     unsigned char buffer[MICROFLO_CMD_SIZE];
     enum State state;
+    enum Framing framing;
+    uint8_t cobsRemaining;
+    bool cobsZeroPending;
+    bool frameInvalid;
+    unsigned char outBuffer[MICROFLO_CMD_SIZE];
+    uint8_t outLength;
+    // SendPackets in progress: runs left, and packets left of current run
+    uint8_t batchRuns;
+    uint8_t batchPackets;
+    bool batchFromStream;
+    // Block upload, see parseUploadByte()
+    uint8_t uploadHeader[4]; // seq, length, crc
+    uint8_t uploadPos;
+    uint8_t uploadMagicPos;
+    uint16_t uploadBlockCrc;
+    uint16_t uploadImageCrc;
+    uint8_t uploadBase;
+    uint8_t uploadReceived;
+    bool uploadGraphEnded;
+    uint8_t uploadLength[MICROFLO_UPLOAD_WINDOW];
+    uint8_t uploadWindow[MICROFLO_UPLOAD_WINDOW][MICROFLO_UPLOAD_BLOCK_SIZE];
+    // Telemetry, see packetSent()
+    TelemetryEncoding telemetryEncoding;
+    uint8_t keyframeInterval;
+    uint8_t nextEvicted;
+    uint8_t telemetryLength;
+    unsigned char telemetryBuffer[MICROFLO_CMD_SIZE];
+    TelemetryChannel channels[MICROFLO_TELEMETRY_CHANNELS];
+    // Graph storage, see storeBytes()
+    IO *storage;
+    bool storing;
+    bool loadingStored;
+    uint16_t storedLength;
+    uint16_t storedCrc;
+    uint8_t storeBuffered;
+    unsigned char storeBuffer[MICROFLO_CMD_SIZE];
+    uint8_t storeBank; // written by current upload, the other one keeps previous graph
+    uint8_t storeSequence;
+    // Debug messages, see emitDebug()
+    DebugEvent debugEvents[MICROFLO_DEBUG_BUFFER_SIZE];
+    uint8_t debugFirst;
+    uint8_t debugQueued;
+    uint16_t debugDropped;
+    InputStream streams[MICROFLO_STREAMS];
 };
 
 
@@ -376,6 +688,13 @@ public:
 
     virtual void sendCommandByte(uint8_t b) = 0;
     void padCommandWithNArguments(int arguments);
+    // Called before the @bytes of a command are sent. Returning false drops the command.
+    // Commands which are not @droppable (telemetry) should only be dropped if waiting for room
+    // would stall the network indefinitely
+    virtual bool beginCommand(int bytes, bool droppable) { return true; }
+    // Whether @bytes can be sent now, without waiting or dropping.
+    // Used to hold back queued messages without counting them as dropped
+    virtual bool canSend(int bytes) { return true; }
 };
 
 class NullHostTransport : public HostTransport {
@@ -395,12 +714,20 @@ public:
     virtual void setup(IO *i, HostCommunication *c);
     virtual void runTick();
     virtual void sendCommandByte(uint8_t b);
+    virtual bool beginCommand(int bytes, bool droppable);
+    virtual bool canSend(int bytes);
 
+private:
+    void writeQueued(bool blocking);
 private:
     IO *io;
     HostCommunication *controller;
     int8_t serialPort;
     int serialBaudrate;
+    uint8_t txBuffer[MICROFLO_HOST_TX_BUFFER_SIZE];
+    int txRead;
+    int txQueued;
+    uint16_t txDropped;
 };
 
 #endif // MICROFLO_H
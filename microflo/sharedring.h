@@ -0,0 +1,130 @@
+/* MicroFlo - Flow-Based Programming for microcontrollers
+ * Copyright (c) 2014 Jon Nordby <jononor@gmail.com>
+ * MicroFlo may be freely distributed under the MIT license
+ */
+
+#ifndef MICROFLO_SHAREDRING_H
+#define MICROFLO_SHAREDRING_H
+
+// Pair of single-producer/single-consumer byte rings in POSIX shared memory,
+// used by SharedMemoryHostTransport. Kept free of other MicroFlo includes
+// so that a supervisor process on the same board can use it directly.
+// Consumers sleep on the producer index with a futex, producers only
+// make a syscall when the consumer has said it is waiting.
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#ifdef MICROFLO_SHARED_RING_LIMIT
+const uint32_t MICROFLO_SHARED_RING_SIZE = MICROFLO_SHARED_RING_LIMIT; // must be power of two
+#else
+const uint32_t MICROFLO_SHARED_RING_SIZE = 64*1024;
+#endif
+const uint32_t MICROFLO_SHARED_MAGIC = 0x6d466c6f; // "mFlo"
+
+struct SharedRing {
+    uint32_t head; // written by producer only
+    uint32_t waiting; // consumer is, or is about to, sleep on head
+    uint8_t padding[56]; // keep producer and consumer indices on separate cache lines
+    uint32_t tail; // written by consumer only
+    uint8_t padding2[60];
+    uint8_t data[MICROFLO_SHARED_RING_SIZE];
+};
+
+struct SharedRings {
+    uint32_t magic;
+    uint32_t hostAttached; // set by host process while it reads toHost
+    uint8_t padding[56];
+    SharedRing toHost;
+    SharedRing toRuntime;
+};
+
+// Open, and if @create make, the shared memory object @name (like "/microflo")
+// Returns 0 on failure
+inline SharedRings *sharedRingsOpen(const char *name, bool create) {
+    const int fd = shm_open(name, create ? O_RDWR|O_CREAT : O_RDWR, 0600);
+    if (fd < 0) {
+        return 0;
+    }
+    if (create && ftruncate(fd, sizeof(SharedRings)) != 0) {
+        close(fd);
+        return 0;
+    }
+    void *p = mmap(0, sizeof(SharedRings), PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        return 0;
+    }
+    SharedRings *rings = (SharedRings *)p;
+    if (create) {
+        memset(rings, 0, sizeof(SharedRings));
+        __atomic_store_n(&rings->magic, MICROFLO_SHARED_MAGIC, __ATOMIC_RELEASE);
+    } else if (__atomic_load_n(&rings->magic, __ATOMIC_ACQUIRE) != MICROFLO_SHARED_MAGIC) {
+        munmap(p, sizeof(SharedRings));
+        return 0;
+    }
+    return rings;
+}
+
+inline void sharedRingsClose(SharedRings *rings) {
+    munmap(rings, sizeof(SharedRings));
+}
+
+inline uint32_t sharedRingFree(const SharedRing *r) {
+    return MICROFLO_SHARED_RING_SIZE - (r->head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE));
+}
+
+// Producer: copy up to @length bytes in, returns number written
+inline uint32_t sharedRingWrite(SharedRing *r, const uint8_t *data, uint32_t length) {
+    const uint32_t free = sharedRingFree(r);
+    const uint32_t n = length < free ? length : free;
+    const uint32_t start = r->head % MICROFLO_SHARED_RING_SIZE;
+    const uint32_t first = (n < MICROFLO_SHARED_RING_SIZE-start) ? n : MICROFLO_SHARED_RING_SIZE-start;
+    memcpy(r->data+start, data, first);
+    memcpy(r->data, data+first, n-first);
+    __atomic_store_n(&r->head, r->head+n, __ATOMIC_SEQ_CST);
+    return n;
+}
+
+// Producer: wake consumer if it sleeps. Cheap when it does not
+inline void sharedRingNotify(SharedRing *r) {
+    if (__atomic_load_n(&r->waiting, __ATOMIC_SEQ_CST)) {
+        syscall(SYS_futex, &r->head, FUTEX_WAKE, 1, 0, 0, 0);
+    }
+}
+
+// Consumer: contiguous readable bytes, in place. Call sharedRingConsume() when done with them
+inline uint32_t sharedRingPeek(SharedRing *r, const uint8_t **data) {
+    const uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    const uint32_t start = r->tail % MICROFLO_SHARED_RING_SIZE;
+    const uint32_t available = head - r->tail;
+    *data = r->data+start;
+    return (available < MICROFLO_SHARED_RING_SIZE-start) ? available : MICROFLO_SHARED_RING_SIZE-start;
+}
+
+inline void sharedRingConsume(SharedRing *r, uint32_t length) {
+    __atomic_store_n(&r->tail, r->tail+length, __ATOMIC_RELEASE);
+}
+
+// Consumer: sleep until data is available or @timeoutMs passed. Returns true if data available
+inline bool sharedRingWait(SharedRing *r, long timeoutMs) {
+    const uint32_t tail = r->tail;
+    __atomic_store_n(&r->waiting, 1, __ATOMIC_SEQ_CST);
+    const uint32_t head = __atomic_load_n(&r->head, __ATOMIC_SEQ_CST);
+    if (head == tail) {
+        timespec timeout;
+        timeout.tv_sec = timeoutMs/1000;
+        timeout.tv_nsec = (timeoutMs%1000)*1000000;
+        syscall(SYS_futex, &r->head, FUTEX_WAIT, head, &timeout, 0, 0);
+    }
+    __atomic_store_n(&r->waiting, 0, __ATOMIC_SEQ_CST);
+    return __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) != tail;
+}
+
+#endif // MICROFLO_SHAREDRING_H
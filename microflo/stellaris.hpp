@@ -10,6 +10,7 @@
 #include "inc/hw_types.h"
 #include "inc/hw_ssi.h"
 #include "driverlib/debug.h"
+#include "driverlib/flash.h"
 #include "driverlib/fpu.h"
 #include "driverlib/gpio.h"
 #include "driverlib/interrupt.h"
@@ -47,6 +48,13 @@ static const unsigned long portPeripherals[6] = {
 #define portBase(pinNumber) ports[pinNumber/8]
 #define pinMask(pinNumber) 0x01 << (pinNumber%8)
 
+// Graph storage in the last 4K of flash, which stellaris.ld keeps free
+#ifndef MICROFLO_STORAGE_FLASH_ADDRESS
+#define MICROFLO_STORAGE_FLASH_ADDRESS 0x3F000
+#endif
+static const unsigned long storageSize = 4*1024;
+static const unsigned long flashEraseBlock = 1024;
+
 volatile unsigned long g_ulSysTickCount = 0;
 static const char * const gMagic = "MAGIC!012";
 
@@ -54,6 +62,9 @@ extern "C" {
     void SysTickIntHandler(void) {
         g_ulSysTickCount++;
     }
+
+    // Implemented in startup_gcc.c, which paints the stack at reset
+    unsigned long StackUnusedBytes(unsigned long ulLimit);
 }
 
 class StellarisIO : public IO {
@@ -108,6 +119,14 @@ public:
         }
 
     }
+    virtual long SerialWriteAvailable(int serialDevice) {
+        if (serialDevice == 0) {
+            // Room in TX FIFO, which hardware drains while we run
+            return UARTSpaceAvail(UART0_BASE) ? 1 : 0;
+        } else {
+            return 0;
+        }
+    }
 
     // Pin config
     virtual void PinSetMode(MicroFlo::PinId pin, IO::PinMode mode) {
@@ -176,6 +195,38 @@ public:
         MICROFLO_DEBUG(debug, DebugLevelError, DebugIoOperationNotImplemented);
     }
 
+    // Stack
+    virtual long StackFreeMinimum(long limit) {
+        return StackUnusedBytes(limit > 0 ? limit : 0);
+    }
+
+    // Storage
+    virtual long StorageSize() {
+        return storageSize;
+    }
+    // Banks are a multiple of the flash erase block
+    virtual bool StorageErase(long offset, long length) {
+        for (unsigned long a=offset; a<(unsigned long)(offset+length); a+=flashEraseBlock) {
+            if (MAP_FlashErase(MICROFLO_STORAGE_FLASH_ADDRESS+a) != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+    virtual bool StorageWrite(long offset, const uint8_t *data, uint8_t length) {
+        // Flash is programmed in words, writes are word aligned
+        unsigned long words[2];
+        if (length > sizeof(words) || length % 4) {
+            return false;
+        }
+        memcpy(words, data, length);
+        return MAP_FlashProgram(words, MICROFLO_STORAGE_FLASH_ADDRESS+offset, length) == 0;
+    }
+    virtual bool StorageRead(long offset, uint8_t *data, uint8_t length) {
+        memcpy(data, (const void *)(MICROFLO_STORAGE_FLASH_ADDRESS+offset), length);
+        return true;
+    }
+
 private:
     const char *magic;
 };
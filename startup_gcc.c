@@ -63,6 +63,14 @@ extern int main(void);
 //*****************************************************************************
 static unsigned long pulStack[256];
 
+//*****************************************************************************
+//
+// Pattern written to the unused part of the stack at reset, used to find the
+// stack high-water mark.
+//
+//*****************************************************************************
+#define STACK_PAINT             0xC5C5C5C5
+
 //*****************************************************************************
 //
 // The vector table.  Note that the proper constructs must be placed on this to
@@ -321,6 +329,16 @@ ResetISR(void)
           "        strlt   r2, [r0], #4\n"
           "        blt     zero_loop");
 
+    //
+    // Paint the stack below the current stack pointer, leaving some margin
+    // for this function's own frame.  The bss zero fill above wiped it.
+    //
+    __asm volatile ("    mov     %0, sp" : "=r" (pulSrc));
+    for(pulDest = pulStack; pulDest < pulSrc - 16; )
+    {
+        *pulDest++ = STACK_PAINT;
+    }
+
     //
     // Enable the floating-point unit.  This must be done here to handle the
     // case where main() uses floating-point and the function prologue saves
@@ -346,6 +364,31 @@ ResetISR(void)
     main();
 }
 
+//*****************************************************************************
+//
+// Returns the number of bytes at the bottom of the stack which still hold the
+// paint pattern, i.e. the minimum amount of free stack seen since reset.  If
+// ulLimit is non-zero, scanning stops once that many free bytes are found.
+//
+//*****************************************************************************
+unsigned long
+StackUnusedBytes(unsigned long ulLimit)
+{
+    unsigned long ulCount = 0;
+
+    while((ulCount < (sizeof(pulStack) / sizeof(pulStack[0]))) &&
+          (pulStack[ulCount] == STACK_PAINT))
+    {
+        ulCount++;
+        if(ulLimit && ((ulCount * sizeof(pulStack[0])) >= ulLimit))
+        {
+            break;
+        }
+    }
+
+    return(ulCount * sizeof(pulStack[0]));
+}
+
 //*****************************************************************************
 //
 // This is the code that gets called when the processor receives a NMI.  This
@@ -42,4 +42,197 @@ describe('Commandstream generation', function(){
           assertStreamsEqual(out, expect);
       })
   })
+  describe('converted to compact framing', function(){
+      var input = "in(SerialIn) OUT -> IN f(Forward) OUT -> IN out(SerialOut)";
+      var expect = commandstream.Buffer([117,67,47,70,108,111,48,50,
+                           2,10,0, 3,15,1,0,
+                           3,11,8,0, 3,11,3,0, 3,11,9,0,
+                           4,12,1,2,0, 4,12,2,3,0,
+                           2,14,0 ]);
+      it('should drop padding and COBS encode each command', function(){
+          var out = commandstream.toCompactStream(commandstream.cmdStreamFromGraph(componentLib, fbp.parse(input)));
+          chai.expect(out.toJSON().toString()).to.equal(expect.toJSON().toString());
+      })
+      it('should decode back to the fixed size commands', function(){
+          var cmd = commandstream.Buffer([103,1,0,2,0,7,0,1]);
+          var frame = commandstream.cobsEncode(cmd);
+          var decoded = commandstream.cobsDecode(frame.slice(0, frame.length-1));
+          chai.expect(decoded.toJSON().toString()).to.equal(cmd.toJSON().toString());
+      })
+      it('should split long batches into blocks of 254 bytes', function(){
+          var values = [];
+          for (var i=0; i<100; i++) {
+              values.push(0x01010101);
+          }
+          var type = commandstream.format.packetTypes.Integer.id;
+          var cmd = commandstream.packetBatchCommand([{ tgt: 1, port: 1, type: type, values: values }]);
+          var frame = commandstream.cobsEncode(cmd, true);
+          chai.expect(Array.prototype.indexOf.call(frame, 0xFF) > 0).to.equal(true);
+          chai.expect(Array.prototype.indexOf.call(frame, 0)).to.equal(frame.length-1);
+          var decoded = commandstream.cobsDecode(frame.slice(0, frame.length-1));
+          chai.expect(decoded.toJSON().toString()).to.equal(cmd.toJSON().toString());
+      })
+  })
+  describe('with an array IIP', function(){
+      var input = "'[1, 300]' -> IN f(Forward)";
+      var expect = commandstream.Buffer([117,67,47,70,108,111,48,49,
+                           10,0,0,0,0,0,0,0,
+                           15,1,0,0,0,0,0,0,
+                           11,3,0,0,0,0,0,0,
+                           19,3,0,0,0,0,0,0,
+                           1,0,9,1, 1,0,7,2, 1,0,0,0, 44,1,0,0, 1,0,10,1,
+                           14,0,0,0,0,0,0,0 ]);
+      it('should send all packets in one batch command', function(){
+          var out = commandstream.cmdStreamFromGraph(componentLib, fbp.parse(input));
+          chai.expect(out.toJSON().toString()).to.equal(expect.toJSON().toString());
+      })
+      it('should keep batch in one frame when compacted', function(){
+          var out = commandstream.toCompactStream(commandstream.cmdStreamFromGraph(componentLib, fbp.parse(input)));
+          var delimiters = 0;
+          for (var i=8; i<out.length; i++) {
+              delimiters += (out[i] === 0) ? 1 : 0;
+          }
+          chai.expect(delimiters).to.equal(5);
+      })
+  })
+  describe('streaming input', function(){
+      it('should pack stream data like a batch run, without target', function(){
+          var cmd = commandstream.streamDataCommand(1, 7, [1, 300]);
+          chai.expect(Array.prototype.slice.call(cmd, 0)).to.deep.equal([25,1,7,2,0,0,0,0, 1,0,0,0, 44,1,0,0]);
+      })
+      it('should keep stream data in one frame when compacted', function(){
+          var magic = commandstream.Buffer([117,67,47,70,108,111,48,49]);
+          var out = commandstream.toCompactStream(Buffer.concat([magic,
+                        commandstream.streamDataCommand(0, 6, [true, false, true]),
+                        commandstream.openStreamCommand(0, 2, 0, 8)]));
+          var delimiters = 0;
+          for (var i=8; i<out.length; i++) {
+              delimiters += (out[i] === 0) ? 1 : 0;
+          }
+          chai.expect(delimiters).to.equal(2);
+      })
+  })
+  describe('stack usage query', function(){
+      it('should carry the alarm threshold after the magic', function(){
+          var cmd = commandstream.queryStackUsageCommand(300);
+          chai.expect(cmd.toString("ascii", 0, 8)).to.equal("uC/Flo01");
+          chai.expect(Array.prototype.slice.call(cmd, 8)).to.deep.equal([18,44,1,0,0,0,0,0]);
+      })
+      it('should query only without a threshold', function(){
+          var cmd = commandstream.queryStackUsageCommand();
+          chai.expect(Array.prototype.slice.call(cmd, 8)).to.deep.equal([18,0,0,0,0,0,0,0]);
+      })
+  })
+  describe('block upload', function(){
+      it('should use CRC-16-CCITT', function(){
+          chai.expect(commandstream.crc16(commandstream.Buffer("123456789"))).to.equal(0x29B1);
+      })
+      it('should protect sequence number and length by block CRC', function(){
+          var payload = commandstream.Buffer([10,0,0,0]);
+          var block = commandstream.uploadBlock(257, payload);
+          chai.expect(block.length).to.equal(9);
+          chai.expect(block[1]).to.equal(1);
+          chai.expect(block[2]).to.equal(4);
+          var crc = commandstream.crc16(payload, commandstream.crc16(commandstream.Buffer([1, 4])));
+          chai.expect(block.readUInt16LE(3)).to.equal(crc);
+      })
+  })
+  describe('compressed for embedding', function(){
+      it('should leave out magic and zero padding', function(){
+          var input = "in(SerialIn) OUT -> IN f(Forward) OUT -> IN out(SerialOut)";
+          var out = commandstream.compressCmdStream(commandstream.cmdStreamFromGraph(componentLib, fbp.parse(input)));
+          chai.expect(Array.prototype.slice.call(out)).to.deep.equal([10, 1<<5|15,1,
+              1<<5|11,8, 1<<5|11,3, 1<<5|11,9, 2<<5|12,1,2, 2<<5|12,2,3, 14]);
+      })
+      it('should store integers as varint, and refer back to equal payloads', function(){
+          var input = "a(Forward) OUT -> IN b(Forward)\n'-100000' -> IN a\n'-100000' -> IN b";
+          var out = commandstream.compressCmdStream(commandstream.cmdStreamFromGraph(componentLib, fbp.parse(input)));
+          chai.expect(Array.prototype.slice.call(out, 10)).to.deep.equal([7<<5|13,1,0,7, 191,154,12,
+              7<<5|13,2,0,0x80|7, 7, 14]);
+      })
+  })
+  describe('precompiled graph image', function(){
+      var input = "in(SerialIn) OUT -> IN f(Forward) OUT -> IN out(SerialOut)";
+      var image = commandstream.graphImageFromCmdStream(
+          commandstream.cmdStreamFromGraph(componentLib, fbp.parse(input)));
+      it('should have node and edge tables after header', function(){
+          chai.expect(image.toString("ascii", 0, 8)).to.equal("uC/FloG1");
+          chai.expect(image.readUInt16LE(10)).to.equal(3);
+          chai.expect(image.readUInt16LE(12)).to.equal(2);
+          chai.expect(image.readUInt16LE(14)).to.equal(0);
+          chai.expect(Array.prototype.slice.call(image, 16, 30)).to.deep.equal([8,0, 3,0, 9,0, 1,2,0,0, 2,3,0,0]);
+      })
+      it('should keep remaining commands as is, and be covered by CRC', function(){
+          chai.expect(image.length).to.equal(16+3*2+2*4+2*8);
+          chai.expect(image[30]).to.equal(15);
+          chai.expect(image[38]).to.equal(14);
+          chai.expect(image.readUInt16LE(8)).to.equal(commandstream.crc16(image.slice(16)));
+      })
+  })
+  describe('delta telemetry', function(){
+      it('should decode keyframes and zigzag varint deltas', function(){
+          var channels = {};
+          var first = commandstream.Buffer([116, 0x17, 0x00, 0x94, 0x35, 0x77, 0x1F, 0x01]);
+          var second = commandstream.Buffer([116, 0x03, 0x1F, 0x02, 0x06, 0x01, 0, 0]);
+          var records = commandstream.decodeTelemetry(first, channels);
+          chai.expect(records.length).to.equal(2);
+          chai.expect(records[0].data).to.equal(2000000000);
+          chai.expect(records[1].data).to.equal(1999999999);
+          records = commandstream.decodeTelemetry(second, channels);
+          chai.expect(records.map(function(r) { return r.data })).to.deep.equal([null, 2000000000, true]);
+      })
+  })
+  describe('subscription modes', function(){
+      it('should parse mode and period', function(){
+          chai.expect(commandstream.parseSubscriptionMode("all")).to.deep.equal({id: 0, param: 0});
+          chai.expect(commandstream.parseSubscriptionMode("every:10")).to.deep.equal({id: 1, param: 10});
+          chai.expect(commandstream.parseSubscriptionMode("summary:1000")).to.deep.equal({id: 3, param: 1000});
+      })
+      it('should reject missing periods', function(){
+          chai.expect(function() { commandstream.parseSubscriptionMode("rate") }).to.throw();
+      })
+  })
+  describe('changing a running graph', function(){
+      var graph = fbp.parse("in(SerialIn) OUT -> IN f(Forward) OUT -> IN out(SerialOut)");
+      commandstream.cmdStreamFromGraph(componentLib, graph);
+      var change = function(command, c) {
+          var cmd = commandstream.graphChangeCommands(componentLib, graph, command, c);
+          if (command === "addnode") {
+              graph.processes[c.id] = c;
+          } else if (command === "removenode") {
+              delete graph.processes[c.id];
+          }
+          return cmd;
+      }
+      var edge = { src: { process: 'f', port: 'out' }, tgt: { process: 'out', port: 'in' } };
+      it('should disconnect an edge by its outport', function(){
+          assertStreamsEqual(change("removeedge", edge), commandstream.Buffer([23,2,0,0,0,0,0,0]));
+      })
+      it('should remove a node and reuse its id', function(){
+          assertStreamsEqual(change("removenode", { id: 'f' }), commandstream.Buffer([22,2,0,0,0,0,0,0]));
+          assertStreamsEqual(change("addnode", { id: 'g', component: 'Forward' }), commandstream.Buffer([11,3,0,0,0,0,0,0]));
+          chai.expect(graph.nodeMap.g.id).to.equal(2);
+          change("addnode", { id: 'h', component: 'Forward' });
+          chai.expect(graph.nodeMap.h.id).to.equal(4);
+      })
+      it('should skip edges of removed nodes', function(){
+          chai.expect(change("removeedge", edge).length).to.equal(0);
+      })
+  })
+  describe('connecting a boolean outport to an integer inport', function(){
+      var input = "t(ToggleBoolean) OUT -> PIN led(DigitalWrite)";
+      it('should fail with port type error', function(){
+          chai.expect(function() {
+              commandstream.cmdStreamFromGraph(componentLib, fbp.parse(input));
+          }).to.throw(/Incompatible port types/);
+      })
+  })
+  describe('sending an integer IIP to a boolean inport', function(){
+      var input = "'1' -> A and(BooleanAnd)";
+      it('should fail with IIP type error', function(){
+          chai.expect(function() {
+              commandstream.cmdStreamFromGraph(componentLib, fbp.parse(input));
+          }).to.throw(/Incompatible IIP type/);
+      })
+  })
 })
@@ -0,0 +1,114 @@
+/* MicroFlo - Flow-Based Programming for microcontrollers
+ * Copyright (c) 2014 Jon Nordby <jononor@gmail.com>
+ * MicroFlo may be freely distributed under the MIT license
+ */
+
+if (typeof process !== 'undefined' && process.execPath && process.execPath.indexOf('node') !== -1) {
+  var chai = require('chai');
+  var distributed = require('../lib/distributed.js')
+} else {
+  var distributed = require('microflo/lib/distributed.js');
+}
+
+var fbp = require("fbp");
+
+describe('Distributed graph', function(){
+  describe('partitioned across two runtimes', function(){
+      var input = "'100' -> INTERVAL timer(Timer) OUT -> IN toggle(ToggleBoolean) OUT -> IN out(DigitalWrite)";
+      var graph = fbp.parse(input);
+      var p = distributed.partitionGraph(graph, { toggle: 'mcu', out: 'mcu' }, 'host');
+      it('should have one partition per runtime', function(){
+          chai.expect(Object.keys(p.partitions).sort()).to.deep.equal(['host', 'mcu']);
+          chai.expect(p.partitions.mcu.processes.toggle.component).to.equal('ToggleBoolean');
+          chai.expect(p.partitions.host.processes.timer.component).to.equal('Timer');
+      });
+      it('should cut the edge between runtimes into a RemoteOut and RemoteIn node', function(){
+          chai.expect(p.remoteEdges.length).to.equal(1);
+          var e = p.remoteEdges[0];
+          chai.expect(e.src).to.equal('host');
+          chai.expect(e.tgt).to.equal('mcu');
+          chai.expect(p.partitions.host.processes[e.proxy].component).to.equal('RemoteOut');
+          chai.expect(p.partitions.mcu.processes[e.proxy].component).to.equal('RemoteIn');
+          chai.expect(p.partitions.host.connections[1]).to.deep.equal({ src: { process: 'timer', port: 'out' },
+                                                                        tgt: { process: e.proxy, port: 'in' } });
+          chai.expect(p.partitions.mcu.connections[0]).to.deep.equal({ src: { process: e.proxy, port: 'out' },
+                                                                       tgt: { process: 'toggle', port: 'in' } });
+      });
+      it('should keep IIPs with their target', function(){
+          var iips = p.partitions.host.connections.filter(function(c) { return !c.src; });
+          chai.expect(iips.length).to.equal(1);
+          chai.expect(iips[0].tgt.process).to.equal('timer');
+          chai.expect(p.partitions.mcu.connections.length).to.equal(2);
+      });
+  });
+
+  describe('forwarding packets', function(){
+      // Write returns false while full, like a socket or serial port that needs to drain
+      var fakeTransport = function() {
+          var t = { writes: [], full: false, drain: undefined };
+          t.on = function(event, callback) {
+              if (event === 'drain') {
+                  t.drain = callback;
+              }
+          };
+          t.write = function(b) {
+              t.writes.push(b);
+              return !t.full;
+          };
+          return t;
+      };
+      // [target, port, type, values] of each run in a SendPackets command, after the magic if any
+      var runsOf = function(b) {
+          var offset = (b[0] === 117) ? 16 : 8;
+          var numRuns = b[offset-7];
+          var runs = [];
+          for (var r=0; r<numRuns; r++) {
+              var run = [b[offset], b[offset+1], b[offset+2], []];
+              var count = b[offset+3];
+              offset += 4;
+              for (var i=0; i<count; i++) {
+                  run[3].push(run[2] === 7 ? b.readInt32LE(offset) : b[offset]);
+                  offset += (run[2] === 7) ? 4 : 1;
+              }
+              runs.push(run);
+          }
+          return runs;
+      };
+
+      var t = fakeTransport();
+      var f = new distributed.PacketForwarder(t, 4);
+      it('should not write before the runtime is ready', function(){
+          f.push(3, 0, 7, 100);
+          f.flush();
+          chai.expect(t.writes.length).to.equal(0);
+      });
+      it('should batch consecutive packets to the same port into one run', function(){
+          f.push(3, 0, 7, -5);
+          f.push(4, 1, 6, true);
+          f.ready = true;
+          f.flush();
+          chai.expect(t.writes.length).to.equal(1);
+          chai.expect(runsOf(t.writes[0])).to.deep.equal([[3, 0, 7, [100, -5]], [4, 1, 6, [1]]]);
+      });
+      it('should stop writing while transport is congested, and drop the oldest packets', function(){
+          t.full = true;
+          f.push(3, 0, 7, 1);
+          f.flush();
+          chai.expect(f.congested).to.equal(true);
+          t.full = false;
+          for (var i=2; i<=6; i++) {
+              f.push(3, 0, 7, i);
+          }
+          f.flush();
+          chai.expect(t.writes.length).to.equal(2);
+          chai.expect(f.dropped).to.equal(1);
+          chai.expect(f.queue.length).to.equal(4);
+      });
+      it('should send what is queued once transport drains', function(){
+          t.drain();
+          chai.expect(f.congested).to.equal(false);
+          chai.expect(t.writes.length).to.equal(3);
+          chai.expect(runsOf(t.writes[2])).to.deep.equal([[3, 0, 7, [3, 4, 5, 6]]]);
+      });
+  });
+});
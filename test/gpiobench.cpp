@@ -0,0 +1,125 @@
+/* MicroFlo - Flow-Based Programming for microcontrollers
+ * Copyright (c) 2014 Jon Nordby <jononor@gmail.com>
+ * MicroFlo may be freely distributed under the MIT license
+ *
+ * GPIO toggle rate of LinuxIO against a fake sysfs tree in a temporary directory,
+ * compared with opening and closing the value file for each access.
+ * With MICROFLO_GPIOCHIP=/dev/gpiochipN (real, gpio-sim or gpio-mockup), also
+ * LinuxGpioChipIO on lines 0-7: one line at a time and all 8 in one call.
+ * Build and run with: make bench-gpio
+ */
+
+#include "microflo.h"
+#include "linux.hpp"
+#include "microflo.hpp"
+
+#include <stdio.h>
+#include <sys/stat.h>
+
+namespace {
+
+const int pin = 17;
+const int toggles = 200000;
+
+double now() {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec/1e9;
+}
+
+void createFile(const std::string &path, const char *contents) {
+    FILE *f = fopen(path.c_str(), "w");
+    fputs(contents, f);
+    fclose(f);
+}
+
+// How LinuxIO accessed pins before file descriptors were kept open
+void openCloseWrite(const std::string &base, int number, bool value) {
+    std::ofstream fs((base + "gpio" + std::to_string(number) + "/value").c_str());
+    fs << (value ? "1" : "0");
+}
+
+bool openCloseRead(const std::string &base, int number) {
+    std::ifstream fs((base + "gpio" + std::to_string(number) + "/value").c_str());
+    std::string res;
+    fs >> res;
+    return res == "1";
+}
+
+void report(const char *label, double elapsed) {
+    printf("%-22s %9.0f toggles/s\n", label, toggles/elapsed);
+}
+
+}
+
+int main(void) {
+    char dir[] = "/tmp/microflo-gpio-XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    const std::string base = std::string(dir) + "/";
+    const std::string pinDir = base + "gpio" + std::to_string(pin);
+    mkdir(pinDir.c_str(), 0755);
+    createFile(base + "export", "");
+    createFile(pinDir + "/direction", "in");
+    createFile(pinDir + "/value", "0");
+    setenv("MICROFLO_GPIO_BASE", base.c_str(), 1);
+
+    double start = now();
+    for (int i=0; i<toggles; i++) {
+        openCloseWrite(base, pin, i % 2);
+    }
+    report("open/close, write", now()-start);
+
+    start = now();
+    bool value = false;
+    for (int i=0; i<toggles; i++) {
+        value ^= openCloseRead(base, pin);
+    }
+    report("open/close, read", now()-start);
+
+    LinuxIO io;
+    io.PinSetMode(pin, IO::OutputPin);
+    start = now();
+    for (int i=0; i<toggles; i++) {
+        io.DigitalWrite(pin, i % 2);
+    }
+    report("LinuxIO, write", now()-start);
+
+    start = now();
+    for (int i=0; i<toggles; i++) {
+        value ^= io.DigitalRead(pin);
+    }
+    report("LinuxIO, read", now()-start);
+
+    const char *chip = getenv("MICROFLO_GPIOCHIP");
+    if (chip && access(chip, R_OK|W_OK) != 0) {
+        perror(chip);
+    } else if (chip) {
+        LinuxGpioChipIO chipIO(chip);
+        MicroFlo::PinId lines[8];
+        for (int i=0; i<8; i++) {
+            lines[i] = i;
+            chipIO.PinSetMode(i, IO::OutputPin);
+        }
+        start = now();
+        for (int i=0; i<toggles; i++) {
+            chipIO.DigitalWrite(0, i % 2);
+        }
+        report("gpiochip, 1 line", now()-start);
+
+        start = now();
+        for (int i=0; i<toggles; i++) {
+            chipIO.DigitalWriteMany(lines, 8, (i % 2) ? 0xFF : 0x00);
+        }
+        report("gpiochip, 8 lines", now()-start);
+    }
+
+    unlink((pinDir + "/value").c_str());
+    unlink((pinDir + "/direction").c_str());
+    unlink((base + "export").c_str());
+    rmdir(pinDir.c_str());
+    rmdir(dir);
+    return 0;
+}
@@ -118,4 +118,82 @@ describe('Network', function(){
         microflo.runtime.uploadGraph(s.transport, cmdstream, graph, handleFunc);
     })
   })
+  describe('Streaming to a port which also has an edge into it', function(){
+    it('returns credit only for stream packets', function(finish){
+
+        var s = new microflo.simulator.RuntimeSimulator();
+        var graph = fbp.parse("a(Forward) OUT -> IN b(Forward)");
+        var cmdstream = microflo.commandstream.cmdStreamFromGraph(componentLib, graph);
+        var format = microflo.commandstream.format;
+
+        var credits = 0;
+        var streamWhileEdgeDelivers = function() {
+            var b = graph.nodeMap['b'].id;
+            var magic = new Buffer(format.commandSize);
+            microflo.commandstream.writeString(magic, 0, format.magicString);
+            s.transport.write(Buffer.concat([magic, microflo.commandstream.openStreamCommand(0, b, 0, 4)]));
+            s.runTick();
+
+            // Only half of the stream packets arrive, while the edge delivers to same port
+            var data = microflo.commandstream.streamDataCommand(0, format.packetTypes.Integer.id, [1, 2, 3, 4]);
+            var half = format.commandSize + 2*4;
+            s.transport.write(data.slice(0, half));
+            s.runTick();
+            for (var i=0; i<3; i++) {
+                s.network.sendMessage(graph.nodeMap['a'].id, 0, 10+i);
+                s.runTick();
+            }
+            s.runTick();
+            assert.equal(credits, 2);
+
+            s.transport.write(data.slice(half));
+            s.runTick();
+            s.runTick();
+            assert.equal(credits, 4);
+            finish();
+        }
+        var handleFunc = function() {
+            if (arguments[0] === "CREDIT") {
+                credits += arguments[2];
+            } else if (arguments[0] === "NETSTART") {
+                // Ticked by hand from here on, outside of the tick that reported NETSTART
+                s.stop();
+                setTimeout(streamWhileEdgeDelivers, 0);
+            }
+        }
+
+        s.start();
+        microflo.runtime.uploadGraph(s.transport, cmdstream, graph, handleFunc);
+    })
+  })
+  describe('Streaming to a subgraph inport', function(){
+    it('returns credit for packets delivered to the child', function(){
+
+        var s = new microflo.simulator.RuntimeSimulator();
+        var net = s.network;
+        var format = microflo.commandstream.format;
+        var subgraphNode = net.addNode(componentLib.getComponent("SubGraph").id);
+        var innerNode = net.addNode(componentLib.getComponent("Forward").id, subgraphNode);
+        net.connectSubgraph(false, subgraphNode, 0, innerNode, 0);
+        net.start();
+
+        var credits = 0;
+        s.transport.on("data", function(b) {
+            for (var i=0; i+format.commandSize<=b.length; i+=format.commandSize) {
+                if (b[i] === format.commands.StreamCredit.id) {
+                    credits += b[i+2];
+                }
+            }
+        });
+        var magic = new Buffer(format.commandSize);
+        microflo.commandstream.writeString(magic, 0, format.magicString);
+        s.transport.write(Buffer.concat([magic,
+            microflo.commandstream.openStreamCommand(0, subgraphNode, 0, 4),
+            microflo.commandstream.streamDataCommand(0, format.packetTypes.Integer.id, [1, 2, 3, 4])]));
+        for (var i=0; i<4; i++) {
+            s.runTick();
+        }
+        assert.equal(credits, 4);
+    })
+  })
 })
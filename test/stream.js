@@ -0,0 +1,58 @@
+/* MicroFlo - Flow-Based Programming for microcontrollers
+ * Copyright (c) 2014 Jon Nordby <jononor@gmail.com>
+ * MicroFlo may be freely distributed under the MIT license
+ */
+
+if (typeof process !== 'undefined' && process.execPath && process.execPath.indexOf('node') !== -1) {
+  var chai = require('chai');
+  var stream = require('../lib/stream.js')
+} else {
+  var stream = require('microflo/lib/stream.js');
+}
+
+// Records the StreamData counts written
+var fakeTransport = function() {
+    var t = { counts: [], opened: 0 };
+    t.write = function(b) {
+        for (var i=0; i<b.length; ) {
+            if (b[i] === 117) {
+                i += 8; // magic
+            } else if (b[i] === 24) {
+                t.opened++;
+                i += 8;
+            } else {
+                t.counts.push(b[i+3]);
+                i += 8 + b[i+3]*4;
+            }
+        }
+    };
+    return t;
+}
+
+describe('Stream to device', function(){
+  describe('with a window of 4 packets', function(){
+      var t = fakeTransport();
+      var writer = new stream.StreamWriter(t, 0, 2, 0, { timeout: 100000 });
+      writer.open();
+      for (var i=0; i<10; i++) {
+          writer.push(i);
+      }
+      it('should not send before the stream is opened', function(){
+          chai.expect(t.opened).to.equal(1);
+          chai.expect(t.counts).to.deep.equal([]);
+      })
+      it('should send no more than the window', function(){
+          writer.handle("STREAMOPEN", 0, 'f', 0, 4);
+          chai.expect(t.counts).to.deep.equal([4]);
+          chai.expect(writer.inFlight()).to.equal(4);
+      })
+      it('should send more as credit comes back', function(){
+          writer.handle("CREDIT", 0, 2);
+          writer.handle("CREDIT", 1, 2);
+          chai.expect(t.counts).to.deep.equal([4, 2]);
+          writer.handle("CREDIT", 0, 4);
+          chai.expect(t.counts).to.deep.equal([4, 2, 4]);
+          writer.close();
+      })
+  })
+})
@@ -0,0 +1,224 @@
+/* MicroFlo - Flow-Based Programming for microcontrollers
+ * Copyright (c) 2014 Jon Nordby <jononor@gmail.com>
+ * MicroFlo may be freely distributed under the MIT license
+ *
+ * Throughput of Linux host transports: Unix domain socket vs shared memory rings.
+ * The runtime side runs in this process, a forked child acts as host and measures.
+ * Build and run with: make bench-linux
+ */
+
+#include "microflo.h"
+#include "linux.hpp"
+#include "microflo.hpp"
+
+#include <stdio.h>
+#include <sys/wait.h>
+
+namespace {
+
+const int telemetryCommands = 1000000;
+const int roundtripCommands = 100000;
+const int roundtripWindow = 64;
+
+double now() {
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec/1e9;
+}
+
+// Host side of one transport, in the child process
+class HostSide {
+public:
+    virtual ~HostSide() {}
+    // Calls @consume on received bytes, waiting if none are available
+    virtual void receive(void (*consume)(const uint8_t *, uint32_t, void *), void *user) = 0;
+    virtual void send(const uint8_t *data, uint32_t length) = 0;
+};
+
+class SocketHostSide : public HostSide {
+public:
+    SocketHostSide(const char *path) {
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (connect(fd, (sockaddr *)&addr, sizeof(addr)) != 0) {
+            perror("connect");
+            exit(1);
+        }
+    }
+    virtual void receive(void (*consume)(const uint8_t *, uint32_t, void *), void *user) {
+        uint8_t buffer[4096];
+        const ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n <= 0) {
+            exit(1);
+        }
+        consume(buffer, n, user);
+    }
+    virtual void send(const uint8_t *data, uint32_t length) {
+        while (length > 0) {
+            const ssize_t n = write(fd, data, length);
+            if (n <= 0) {
+                exit(1);
+            }
+            data += n;
+            length -= n;
+        }
+    }
+private:
+    int fd;
+};
+
+class SharedMemoryHostSide : public HostSide {
+public:
+    SharedMemoryHostSide(const char *name) {
+        rings = sharedRingsOpen(name, false);
+        if (!rings) {
+            perror("shm_open");
+            exit(1);
+        }
+        // Skip anything written before we attached
+        sharedRingConsume(&rings->toHost, rings->toHost.head - rings->toHost.tail);
+        __atomic_store_n(&rings->hostAttached, 1, __ATOMIC_RELEASE);
+    }
+    virtual void receive(void (*consume)(const uint8_t *, uint32_t, void *), void *user) {
+        const uint8_t *data;
+        uint32_t length = sharedRingPeek(&rings->toHost, &data);
+        if (length == 0) {
+            sharedRingWait(&rings->toHost, 10);
+            return;
+        }
+        consume(data, length, user); // in place
+        sharedRingConsume(&rings->toHost, length);
+    }
+    virtual void send(const uint8_t *data, uint32_t length) {
+        while (length > 0) {
+            const uint32_t n = sharedRingWrite(&rings->toRuntime, data, length);
+            data += n;
+            length -= n;
+        }
+    }
+private:
+    SharedRings *rings;
+};
+
+struct Counter {
+    uint8_t wanted;
+    long position;
+    long count;
+};
+
+void countCommands(const uint8_t *data, uint32_t length, void *user) {
+    Counter *c = (Counter *)user;
+    for (uint32_t i=0; i<length; i++, c->position++) {
+        if (c->position % MICROFLO_CMD_SIZE == 0 && data[i] == c->wanted) {
+            c->count++;
+        }
+    }
+}
+
+// Child: measure, and report the two results on @results
+void runHost(HostSide *host, int results) {
+    double elapsed[2];
+    write(results, "r", 1);
+
+    Counter telemetry = { GraphCmdPacketSent, 0, 0 };
+    double start = now();
+    while (telemetry.count < telemetryCommands) {
+        host->receive(countCommands, &telemetry);
+    }
+    elapsed[0] = now()-start;
+
+    const uint8_t magic[] = { 'u','C','/','F','l','o','0','1' };
+    const uint8_t cmd[MICROFLO_CMD_SIZE] = { GraphCmdConfigureDebug, DebugLevelError };
+    host->send(magic, sizeof(magic));
+    Counter replies = { GraphCmdDebugChanged, telemetry.position, 0 };
+    start = now();
+    long sent = 0;
+    while (replies.count < roundtripCommands) {
+        while (sent < roundtripCommands && sent - replies.count < roundtripWindow) {
+            host->send(cmd, sizeof(cmd));
+            sent++;
+        }
+        host->receive(countCommands, &replies);
+    }
+    elapsed[1] = now()-start;
+
+    write(results, elapsed, sizeof(elapsed));
+    _exit(0);
+}
+
+void benchmark(const char *label, const std::string &address, HostTransport *transport) {
+    LinuxIO io;
+    Network network(&io);
+    HostCommunication controller;
+    transport->setup(&io, &controller);
+    controller.setup(&network, transport);
+
+    int results[2];
+    if (pipe(results) != 0) {
+        return;
+    }
+    const pid_t child = fork();
+    if (child == 0) {
+        close(results[0]);
+        HostSide *host = (address.compare(0, 4, "shm:") == 0)
+                ? (HostSide *)new SharedMemoryHostSide(address.c_str()+4)
+                : (HostSide *)new SocketHostSide(address.c_str()+5);
+        runHost(host, results[1]);
+    }
+    close(results[1]);
+    fcntl(results[0], F_SETFL, O_NONBLOCK);
+
+    // Accept the host
+    char ready;
+    while (read(results[0], &ready, 1) != 1) {
+        transport->runTick();
+    }
+    for (int i=0; i<100; i++) {
+        transport->runTick();
+        usleep(100);
+    }
+
+    // Telemetry, like packetSent() would produce it
+    const uint8_t packet[MICROFLO_CMD_SIZE] = { GraphCmdPacketSent, 1, 0, 2, 0, MsgInteger, 42, 0 };
+    for (int i=0; i<telemetryCommands; i++) {
+        while (!transport->beginCommand(MICROFLO_CMD_SIZE, true)) {
+            transport->runTick();
+        }
+        for (size_t j=0; j<MICROFLO_CMD_SIZE; j++) {
+            transport->sendCommandByte(packet[j]);
+        }
+        if (i % 64 == 0) {
+            transport->runTick();
+        }
+    }
+
+    // Serve the request/reply part until host has its results
+    double elapsed[2];
+    while (read(results[0], elapsed, sizeof(elapsed)) != sizeof(elapsed)) {
+        transport->runTick();
+    }
+    waitpid(child, 0, 0);
+    close(results[0]);
+
+    printf("%-14s telemetry: %9.0f commands/s %7.1f MB/s   request/reply: %8.0f commands/s\n", label,
+           telemetryCommands/elapsed[0], telemetryCommands*MICROFLO_CMD_SIZE/elapsed[0]/1e6,
+           roundtripCommands/elapsed[1]);
+}
+
+}
+
+int main(void) {
+    char unixAddress[64];
+    char shmAddress[64];
+    snprintf(unixAddress, sizeof(unixAddress), "unix:/tmp/microflo-bench-%d", (int)getpid());
+    snprintf(shmAddress, sizeof(shmAddress), "shm:/microflo-bench-%d", (int)getpid());
+
+    SocketHostTransport socketTransport(unixAddress);
+    benchmark("unix socket", unixAddress, &socketTransport);
+    SharedMemoryHostTransport sharedMemoryTransport(shmAddress);
+    benchmark("shared memory", shmAddress, &sharedMemoryTransport);
+    return 0;
+}
@@ -54,3 +54,29 @@ describe('WebSocket API', function(){
     })
   })
 })
+
+describe('Edge data batching', function(){
+    it('should send the messages of a period in one frame, in order', function(done){
+        var sent = [];
+        var batcher = new microflo.runtime.EdgeDataBatcher(function(m) { sent.push(m); }, 10);
+        var data = function(src, value) {
+            return {protocol: "network", command: "data", payload: {
+                src: {node: src, port: "out"}, tgt: {node: "b", port: "in"}, data: value }};
+        }
+        batcher.push(data("a", 1));
+        batcher.push(data("c", true));
+        batcher.push(data("a", 2));
+        assert.equal(sent.length, 0);
+        setTimeout(function() {
+            assert.equal(sent.length, 1);
+            assert.deepEqual(sent[0], [data("a", 1), data("c", true), data("a", 2)]);
+            batcher.push(data("a", 3));
+            batcher.flush();
+            assert.equal(sent.length, 2);
+            assert.deepEqual(sent[1], data("a", 3));
+            batcher.flush();
+            assert.equal(sent.length, 2);
+            done();
+        }, 30);
+    })
+})